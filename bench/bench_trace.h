@@ -0,0 +1,122 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Synthetic CAN traces shared by the benchmarks.
+
+#ifndef BENCH_TRACE_H_
+#define BENCH_TRACE_H_
+
+#include <dw/sensors/canbus/CAN.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define IMU_ADDRESS         0x80
+
+struct DataPgn
+{
+    const char* name;
+    uint32_t    id;
+};
+
+// Default data PGNs of the IMU, priority 6
+static const DataPgn dataPgns[] = {
+    {"SSI1",          0x18F02900 | IMU_ADDRESS},
+    {"ANGULAR_RATE",  0x18F02A00 | IMU_ADDRESS},
+    {"ACCEL",         0x18F02D00 | IMU_ADDRESS},
+    {"MAGNETOMETER",  0x18FF6A00 | IMU_ADDRESS},
+};
+static const size_t dataPgnCount = sizeof(dataPgns) / sizeof(dataPgns[0]);
+
+// Plausible payload around the zero point of each field, with noise
+static void fillPayload(uint32_t id, std::mt19937& rng, dwCANMessage* message)
+{
+    std::uniform_int_distribution<int> noise(-200, 200);
+    uint16_t words[3];
+
+    message->size = 8;
+    switch ((id >> 8) & 0xFFFF)
+    {
+    case 0xF029:    // SSI1: 24 bit pitch and roll around 0 degrees, latency
+    {
+        uint32_t pitch = 8192000 + noise(rng);
+        uint32_t roll  = 8192000 + noise(rng);
+        message->data[0] = pitch & 0xFF;
+        message->data[1] = (pitch >> 8) & 0xFF;
+        message->data[2] = (pitch >> 16) & 0xFF;
+        message->data[3] = roll & 0xFF;
+        message->data[4] = (roll >> 8) & 0xFF;
+        message->data[5] = (roll >> 16) & 0xFF;
+        message->data[6] = 0;
+        message->data[7] = 4;
+        return;
+    }
+    case 0xF02A:    // Angular rate, 1/128 deg/s with -250 deg/s offset
+        for (int i = 0; i < 3; i++)
+            words[i] = static_cast<uint16_t>(32000 + noise(rng));
+        break;
+    case 0xF02D:    // Acceleration, 0.01 m/s^2 with -320 m/s^2 offset, z at 1g
+        words[0] = static_cast<uint16_t>(32000 + noise(rng));
+        words[1] = static_cast<uint16_t>(32000 + noise(rng));
+        words[2] = static_cast<uint16_t>(32981 + noise(rng));
+        break;
+    default:        // Magnetometer, 0.025 uT with -800 uT offset
+        for (int i = 0; i < 3; i++)
+            words[i] = static_cast<uint16_t>(32000 + noise(rng));
+        break;
+    }
+    memcpy(message->data, words, sizeof(words));
+    message->data[6] = 0;
+    message->data[7] = 4;
+}
+
+// Trace with imuShare of the messages from the IMU cycling through its data
+// PGNs. Foreign messages come from other source addresses, a quarter of them
+// reuse the IMU PGNs so validation cannot reject them on the PGN alone.
+static std::vector<dwCANMessage> makeTrace(size_t count, double imuShare, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<dwCANMessage> trace(count);
+    dwTime_t timestamp = 1000000;
+    size_t imuIndex    = 0;
+
+    for (auto& message : trace)
+    {
+        memset(&message, 0, sizeof(message));
+        timestamp += 250;
+        message.timestamp_us = timestamp;
+
+        if (share(rng) < imuShare)
+        {
+            message.id = dataPgns[imuIndex++ % dataPgnCount].id;
+            fillPayload(message.id, rng, &message);
+            continue;
+        }
+
+        uint8_t source = static_cast<uint8_t>(byte(rng));
+        if (source == IMU_ADDRESS)
+            source++;
+        if (byte(rng) < 64)
+            message.id = (dataPgns[byte(rng) % dataPgnCount].id & 0xFFFFFF00) | source;
+        else
+            message.id = (static_cast<uint32_t>(byte(rng) & 0x1C) << 24) | (byte(rng) << 16) | (byte(rng) << 8) | source;
+        message.size = 8;
+        for (int i = 0; i < 8; i++)
+            message.data[i] = static_cast<uint8_t>(byte(rng));
+    }
+    return trace;
+}
+
+#endif // BENCH_TRACE_H_
@@ -0,0 +1,460 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Micro-benchmarks of the OpenIMU300 decoder and the plugin entry points.
+//
+// Runs on synthetic CAN traces with a controlled share of foreign traffic and
+// reports the cost per message. Build with -DBUILD_BENCHMARKS=ON.
+//
+// Usage: imu_bench [--messages=N] [--min-time=ms] [--json=path]
+
+#include <dw/sensors/plugins/imu/IMUPlugin.h>
+#include <openimu300_plugin.h>
+#include <message_pool.h>
+#include <spsc_ring.h>
+#include "bench_trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define PUSH_CHUNK          64      // Messages per pushData() call, below the plugin queue size
+#define SAMPLE_POOL_SIZE    256     // Message slots, the plugin default
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t    operations;
+    double      seconds;
+};
+
+static volatile uint64_t sink;   // Keeps benchmarked results alive
+
+//------------------------------------------------------------------------------
+// Runner
+//------------------------------------------------------------------------------
+
+// Repeats body, which performs operationsPerCall operations, for at least minTime
+template <typename Body>
+static BenchResult runBenchmark(const std::string& name, uint64_t operationsPerCall, double minTime, Body body)
+{
+    body();    // Warm caches and branch predictors
+
+    uint64_t calls = 0;
+    auto start     = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do
+    {
+        body();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minTime);
+
+    BenchResult result = {name, calls * operationsPerCall, elapsed};
+    printf("%-40s %10.1f ns/op %14.0f op/s\n", name.c_str(),
+           result.seconds * 1e9 / result.operations, result.operations / result.seconds);
+    return result;
+}
+
+static std::string shareName(double imuShare)
+{
+    return std::to_string(static_cast<int>(imuShare * 100 + 0.5)) + "pct_imu";
+}
+
+//------------------------------------------------------------------------------
+// Switch decoder the table driven one replaced, kept as the baseline of the
+// decode/ benchmarks. Same arithmetic, with the SSI1 scale corrected.
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uint16_t roll_rate;
+    uint16_t pitch_rate;
+    uint16_t yaw_rate;
+    uint8_t  merit;
+    uint8_t  measurement_latency;
+} legacyAngularRate;
+
+typedef struct {
+    uint16_t acceleration_x;
+    uint16_t acceleration_y;
+    uint16_t acceleration_z;
+    uint8_t  merit;
+    uint8_t  rsvd;
+} legacyAccelSensor;
+
+typedef struct {
+    uint16_t mag_x;
+    uint16_t mag_y;
+    uint16_t mag_z;
+    uint16_t unused;
+} legacyMagSensor;
+
+typedef struct {
+    uint64_t pitch           : 24;
+    uint64_t roll            : 24;
+    uint64_t merit           : 8;
+    uint64_t measure_latency : 8;
+} legacySlopeSensor;
+
+__attribute__((noinline)) static bool legacyDecodePayload(imuMessages type, const uint8_t* payload, dwIMUFrame* frame, uint8_t* sensorLatency)
+{
+    const float32_t toRad = 0.017453292519943F;
+    switch (type)
+    {
+    case ANGULAR_RATE_PT:
+    {
+        auto ptr = reinterpret_cast<const legacyAngularRate*>(payload);
+        frame->turnrate[0] = (static_cast<float32_t>(ptr->roll_rate) * (1 / 128.0) - 250.0) * toRad;
+        frame->turnrate[1] = (static_cast<float32_t>(ptr->pitch_rate) * (1 / 128.0) - 250.0) * toRad;
+        frame->turnrate[2] = (static_cast<float32_t>(ptr->yaw_rate) * (1 / 128.0) - 250.0) * toRad;
+        frame->flags |= DW_IMU_ROLL_RATE | DW_IMU_PITCH_RATE | DW_IMU_YAW_RATE;
+        *sensorLatency = ptr->measurement_latency;
+        return true;
+    }
+    case SSI1_PT:
+    {
+        auto ptr = reinterpret_cast<const legacySlopeSensor*>(payload);
+        frame->orientation[0] = static_cast<float32_t>(ptr->roll) * (1 / 32768.0) - 250.0;
+        frame->orientation[1] = static_cast<float32_t>(ptr->pitch) * (1 / 32768.0) - 250.0;
+        frame->orientation[2] = 0;
+        frame->flags |= DW_IMU_ROLL | DW_IMU_PITCH;
+        *sensorLatency = static_cast<uint8_t>(ptr->measure_latency);
+        return true;
+    }
+    case ACCEL_PT:
+    {
+        auto ptr = reinterpret_cast<const legacyAccelSensor*>(payload);
+        frame->acceleration[0] = static_cast<float32_t>(ptr->acceleration_x) * 0.01f - 320.0;
+        frame->acceleration[1] = static_cast<float32_t>(ptr->acceleration_y) * 0.01f - 320.0;
+        frame->acceleration[2] = static_cast<float32_t>(ptr->acceleration_z) * 0.01f - 320.0;
+        frame->flags |= DW_IMU_ACCELERATION_X | DW_IMU_ACCELERATION_Y | DW_IMU_ACCELERATION_Z;
+        *sensorLatency = 0;
+        return true;
+    }
+    case MAGNETOMETER_PT:
+    {
+        auto ptr = reinterpret_cast<const legacyMagSensor*>(payload);
+        frame->magnetometer[0] = ((static_cast<float32_t>(ptr->mag_x) * 0.00025f) - 8) * 100;
+        frame->magnetometer[1] = ((static_cast<float32_t>(ptr->mag_y) * 0.00025f) - 8) * 100;
+        frame->magnetometer[2] = ((static_cast<float32_t>(ptr->mag_z) * 0.00025f) - 8) * 100;
+        frame->flags |= DW_IMU_MAGNETOMETER_X | DW_IMU_MAGNETOMETER_Y | DW_IMU_MAGNETOMETER_Z;
+        *sensorLatency = 0;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// imuMessages of dataPgns, in the same order
+static const imuMessages dataPgnTypes[] = {SSI1_PT, ANGULAR_RATE_PT, ACCEL_PT, MAGNETOMETER_PT};
+static_assert(sizeof(dataPgnTypes) / sizeof(dataPgnTypes[0]) == dataPgnCount, "dataPgnTypes must match dataPgns");
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+
+static void benchValidation(size_t count, double minTime, std::vector<BenchResult>* results)
+{
+    OpenIMU300 imu(0x00, IMU_ADDRESS);
+    const double shares[] = {1.0, 0.5, 0.1};
+
+    for (double imuShare : shares)
+    {
+        std::vector<dwCANMessage> trace = makeTrace(count, imuShare, 1);
+        results->push_back(runBenchmark("isValidMessage/" + shareName(imuShare), count, minTime, [&]() {
+            uint64_t valid = 0;
+            for (const auto& message : trace)
+                valid += imu.isValidMessage(message.id);
+            sink = valid;
+        }));
+    }
+}
+
+static void benchDecode(size_t count, double minTime, std::vector<BenchResult>* results)
+{
+    OpenIMU300 imu(0x00, IMU_ADDRESS);
+    std::mt19937 rng(2);
+
+    for (size_t p = 0; p < dataPgnCount; p++)
+    {
+        const DataPgn& pgn = dataPgns[p];
+        std::vector<dwCANMessage> trace(count);
+        for (auto& message : trace)
+        {
+            memset(&message, 0, sizeof(message));
+            message.id = pgn.id;
+            fillPayload(pgn.id, rng, &message);
+        }
+
+        // Payload decode alone, table driven decoder against the switch it replaced
+        const imuMessages type = dataPgnTypes[p];
+        results->push_back(runBenchmark(std::string("decode/") + pgn.name + "/table", count, minTime, [&]() {
+            dwIMUFrame frame;
+            uint64_t flags   = 0;
+            uint8_t latency  = 0;
+            for (const auto& message : trace)
+            {
+                frame = {};
+                OpenIMU300::decodePayload(type, message.data, &frame, &latency);
+                flags += frame.flags + latency + static_cast<uint64_t>(frame.turnrate[0] + frame.orientation[0]);
+            }
+            sink = flags;
+        }));
+        results->push_back(runBenchmark(std::string("decode/") + pgn.name + "/switch", count, minTime, [&]() {
+            dwIMUFrame frame;
+            uint64_t flags   = 0;
+            uint8_t latency  = 0;
+            for (const auto& message : trace)
+            {
+                frame = {};
+                legacyDecodePayload(type, message.data, &frame, &latency);
+                flags += frame.flags + latency + static_cast<uint64_t>(frame.turnrate[0] + frame.orientation[0]);
+            }
+            sink = flags;
+        }));
+
+        results->push_back(runBenchmark(std::string("parseDataPacket/") + pgn.name, count, minTime, [&]() {
+            dwIMUFrame frame;
+            uint64_t flags = 0;
+            for (const auto& message : trace)
+            {
+                frame = {};
+                imu.parseDataPacket(message, &frame);
+                flags += frame.flags;
+            }
+            sink = flags;
+        }));
+    }
+
+    // Mixed trace, PGNs interleaved like on the bus
+    std::vector<dwCANMessage> trace = makeTrace(count, 1.0, 3);
+    std::vector<dwIMUFrame> frames(count);
+    results->push_back(runBenchmark("parseDataPacket/mixed", count, minTime, [&]() {
+        uint64_t decoded = 0;
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            frames[i] = {};
+            frames[i].timestamp_us = trace[i].timestamp_us;
+            decoded += imu.parseDataPacket(trace[i], &frames[i]);
+        }
+        sink = decoded;
+    }));
+}
+
+static void benchConfig(double minTime, std::vector<BenchResult>* results)
+{
+    // Runs on its own OpenIMU300, each instance has its own PGN table
+    const struct
+    {
+        const char* name;
+        const char* params;
+    } cases[] = {
+        {"init/minimal", "decoder-path=libopenimu_plugin.so,can-proto=can.socket,device=can0"},
+        {"init/typical", "decoder-path=libopenimu_plugin.so,can-proto=can.socket,device=can0,"
+                         "packetRate=2,packetType=7,rateLPF=25,accelLPF=25,orientation=0"},
+        {"init/full",    "decoder-path=libopenimu_plugin.so,can-proto=can.socket,device=can0,"
+                         "resetAlgoPS=80,setPacketRatePS=85,setPacketTypePS=86,setFilterCutoffPS=87,"
+                         "setOrientationPS=88,packetRate=2,packetType=7,orientation=0,rateLPF=25,"
+                         "accelLPF=25,resetAlgo=1,latencyCompensation=1,canBitrate=500"},
+    };
+
+    OpenIMU300 imu(0x00, IMU_ADDRESS);
+    for (const auto& c : cases)
+    {
+        std::string params = c.params;
+        results->push_back(runBenchmark(c.name, 1, minTime, [&]() {
+            dwCANMessage* messages = nullptr;
+            uint8_t count          = 0;
+            if (!imu.init(params, &messages, &count))
+            {
+                std::cerr << c.name << ": init failed\n";
+                exit(1);
+            }
+            sink = count;
+        }));
+    }
+}
+
+// pushData -> parseDataBuffer through the exported function table, as the
+// DriveWorks sensor layer drives a virtual sensor
+static void benchPlugin(size_t count, double minTime, std::vector<BenchResult>* results)
+{
+    dwSensorIMUPluginFunctionTable functions;
+    if (dwSensorIMUPlugin_getFunctionTable(&functions) != DW_SUCCESS)
+    {
+        std::cerr << "dwSensorIMUPlugin_getFunctionTable failed\n";
+        exit(1);
+    }
+
+    const double shares[] = {1.0, 0.5};
+    for (double imuShare : shares)
+    {
+        dwSensorPluginSensorHandle_t sensor = nullptr;
+        dwSensorPluginProperties properties;
+        if (functions.common.createHandle(&sensor, &properties, nullptr, DW_NULL_HANDLE) != DW_SUCCESS)
+        {
+            std::cerr << "createHandle failed\n";
+            exit(1);
+        }
+
+        std::vector<dwCANMessage> trace = makeTrace(count, imuShare, 4);
+        results->push_back(runBenchmark("pushData_parseData/" + shareName(imuShare), count, minTime, [&]() {
+            uint64_t frames = 0;
+            for (size_t offset = 0; offset < trace.size(); offset += PUSH_CHUNK)
+            {
+                size_t chunk  = std::min<size_t>(PUSH_CHUNK, trace.size() - offset);
+                size_t pushed = 0;
+                functions.common.pushData(&pushed, reinterpret_cast<const uint8_t*>(&trace[offset]),
+                                          chunk * sizeof(dwCANMessage), sensor);
+
+                dwIMUFrame frame;
+                size_t consumed = 0;
+                dwStatus status;
+                while ((status = functions.parseDataBuffer(&frame, &consumed, sensor)) != DW_NOT_AVAILABLE)
+                {
+                    frames += (status == DW_SUCCESS);
+                }
+            }
+            sink = frames;
+        }));
+
+        functions.common.release(sensor);
+    }
+}
+
+// Message hand-off from readRawData to parseData: the slot copied into the
+// queue (default) against the slot queued by pointer (zeroCopy=1). Single
+// threaded, so it measures the per message cost of each path.
+static void benchMessagePath(size_t count, double minTime, std::vector<BenchResult>* results)
+{
+    std::vector<dwCANMessage> trace = makeTrace(count, 1.0, 5);
+
+    MessagePool slots(SAMPLE_POOL_SIZE);
+    SPSCRing<dwCANMessage, PUSH_CHUNK> copyQueue;
+    results->push_back(runBenchmark("messagePath/copy", count, minTime, [&]() {
+        uint64_t ids = 0;
+        for (size_t offset = 0; offset < trace.size(); offset += PUSH_CHUNK)
+        {
+            size_t chunk = std::min<size_t>(PUSH_CHUNK, trace.size() - offset);
+            for (size_t i = 0; i < chunk; i++)
+            {
+                dwCANMessage* slot = slots.get();         // readRawData
+                *slot              = trace[offset + i];
+                copyQueue.push(*slot);                    // pushData
+                slots.release(slot);                      // returnRawData
+            }
+            while (const dwCANMessage* message = copyQueue.front())
+            {
+                dwCANMessage copy = *message;             // parseData
+                copyQueue.pop();
+                ids += copy.id;
+            }
+        }
+        sink = ids;
+    }));
+
+    MessagePool pool(SAMPLE_POOL_SIZE);
+    SPSCRing<const dwCANMessage*, PUSH_CHUNK> refQueue;
+    std::vector<dwCANMessage*> returned(PUSH_CHUNK);
+    results->push_back(runBenchmark("messagePath/pool", count, minTime, [&]() {
+        uint64_t ids = 0;
+        for (size_t offset = 0; offset < trace.size(); offset += PUSH_CHUNK)
+        {
+            size_t chunk = std::min<size_t>(PUSH_CHUNK, trace.size() - offset);
+            for (size_t i = 0; i < chunk; i++)
+            {
+                dwCANMessage* slot = pool.get();          // readRawData
+                *slot              = trace[offset + i];
+                pool.addRef(slot);                        // pushData
+                refQueue.push(slot);
+                returned[i] = slot;
+            }
+            for (size_t i = 0; i < chunk; i++)
+                pool.release(returned[i]);                // returnRawData
+            while (const dwCANMessage* const* message = refQueue.front())
+            {
+                ids += (*message)->id;                    // parseData
+                pool.release(*message);
+                refQueue.pop();
+            }
+        }
+        sink = ids;
+    }));
+}
+
+//------------------------------------------------------------------------------
+
+static bool writeJson(const std::string& path, size_t messages, const std::vector<BenchResult>& results)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << "{\n  \"messages\": " << messages << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"operations\": " << r.operations
+            << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_op\": " << r.seconds * 1e9 / r.operations
+            << ", \"ops_per_sec\": " << r.operations / r.seconds << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char** argv)
+{
+    size_t messages = 4096;
+    double minTime  = 0.5;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 11, "--messages=") == 0)
+            messages = strtoul(arg.c_str() + 11, nullptr, 10);
+        else if (arg.compare(0, 11, "--min-time=") == 0)
+            minTime = strtod(arg.c_str() + 11, nullptr) / 1000.0;
+        else if (arg.compare(0, 7, "--json=") == 0)
+            jsonPath = arg.substr(7);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--messages=N] [--min-time=ms] [--json=path]\n";
+            return 1;
+        }
+    }
+    if (messages == 0)
+        messages = 1;
+
+    std::vector<BenchResult> results;
+    benchValidation(messages, minTime, &results);
+    benchDecode(messages, minTime, &results);
+    benchConfig(minTime, &results);
+    benchPlugin(messages, minTime, &results);
+    benchMessagePath(messages, minTime, &results);
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, messages, results))
+    {
+        std::cerr << "Cannot write " << jsonPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
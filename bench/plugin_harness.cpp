@@ -0,0 +1,353 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// End-to-end harness: drives the plugin through its exported function table
+// the way the DriveWorks sensor layer does, with the CAN traffic coming from
+// the stand-in's in-memory bus.
+//
+// A producer thread transmits a synthetic trace at a fixed message rate, the
+// main thread runs readRawData -> pushData -> parseDataBuffer ->
+// returnRawData. Frames carry the bus receive time, so the time from
+// transmission to the decoded frame is measured without extra bookkeeping
+// (leave latencyCompensation off, it moves frame timestamps).
+//
+// With --simulate the traffic comes from the OpenIMU300 simulator instead,
+// which also applies the configuration the plugin sends at start and answers
+// its readback requests. Lowering --basePeriod runs the simulated sensor
+// faster than the real one. --restarts starts and stops the plugin that many
+// times before the measured run, as a restart of the stack would, to see the
+// configuration time of warm starts (configDiff=, configCache=).
+// --reconfigure=params@ms changes parameters through
+// dwSensorIMUPlugin_reconfigure() that long into the run, without stopping,
+// and reports when the change was confirmed and the new rate seen.
+//
+// Usage: plugin_harness [--messages=N] [--rate=msg/s] [--foreign=share]
+//                       [--params=extra,plugin,params] [--json=path]
+//        plugin_harness --simulate [--duration=ms] [--basePeriod=us]
+//                       [--jitter=us] [--drop=p] [--flood=msg/s]
+//                       [--restarts=N] [--reconfigure=params@ms] ...
+
+#include <dw/sensors/plugins/imu/IMUPlugin.h>
+#include <dw_standin/VirtualCANBus.hpp>
+#include <can_transport.h>
+#include <imu_configurator.h>
+#include <imu_plugin_config.h>
+#include "bench_trace.h"
+#include "../sim/openimu300_simulator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HARNESS_BUS           "harness0"
+#define HARNESS_READ_TIMEOUT  100000    // us, end of run once the producer is done
+
+struct HarnessResult
+{
+    size_t   transmitted;
+    size_t   imuTransmitted;
+    size_t   frames;
+    double   seconds;
+    std::vector<dwTime_t> latencies;    // us, sorted
+};
+
+static dwTime_t percentile(const std::vector<dwTime_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+// Transmits the trace, rate 0 sends as fast as possible
+static void produce(const std::vector<dwCANMessage>& trace, double rate, std::atomic<bool>* done)
+{
+    dw::standin::VirtualCANPort port(HARNESS_BUS);
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        if (rate > 0)
+            std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<int64_t>(i * 1e6 / rate)));
+        port.send(trace[i]);
+    }
+    *done = true;
+}
+
+static bool writeJson(const std::string& path, double rate, double foreign, const HarnessResult& r)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << "{\n"
+        << "  \"rate\": " << rate << ",\n"
+        << "  \"foreign_share\": " << foreign << ",\n"
+        << "  \"transmitted\": " << r.transmitted << ",\n"
+        << "  \"imu_transmitted\": " << r.imuTransmitted << ",\n"
+        << "  \"frames\": " << r.frames << ",\n"
+        << "  \"seconds\": " << r.seconds << ",\n"
+        << "  \"frames_per_sec\": " << r.frames / r.seconds << ",\n"
+        << "  \"latency_us\": {\"p50\": " << percentile(r.latencies, 0.5)
+        << ", \"p90\": " << percentile(r.latencies, 0.9)
+        << ", \"p99\": " << percentile(r.latencies, 0.99)
+        << ", \"max\": " << (r.latencies.empty() ? 0 : r.latencies.back()) << "}\n"
+        << "}\n";
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char** argv)
+{
+    size_t messages = 20000;
+    double rate     = 400;     // Four data PGNs at 100Hz
+    double foreign  = 0.0;
+    std::string extraParams;
+    std::string jsonPath;
+    bool simulate                 = false;
+    dwTime_t duration_us          = 5000000;
+    int restarts                  = 0;
+    std::string reconfigParams;
+    dwTime_t reconfigAt_us        = -1;
+    simulatorOptions_t simOptions = OpenIMU300Simulator::defaultOptions();
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 11, "--messages=") == 0)
+            messages = strtoul(arg.c_str() + 11, nullptr, 10);
+        else if (arg.compare(0, 7, "--rate=") == 0)
+            rate = strtod(arg.c_str() + 7, nullptr);
+        else if (arg.compare(0, 10, "--foreign=") == 0)
+            foreign = std::min(1.0, std::max(0.0, strtod(arg.c_str() + 10, nullptr)));
+        else if (arg.compare(0, 9, "--params=") == 0)
+            extraParams = arg.substr(9);
+        else if (arg.compare(0, 7, "--json=") == 0)
+            jsonPath = arg.substr(7);
+        else if (arg == "--simulate")
+            simulate = true;
+        else if (arg.compare(0, 11, "--duration=") == 0)
+            duration_us = strtoll(arg.c_str() + 11, nullptr, 10) * 1000;
+        else if (arg.compare(0, 13, "--basePeriod=") == 0)
+            simOptions.basePeriod_us = strtoll(arg.c_str() + 13, nullptr, 10);
+        else if (arg.compare(0, 9, "--jitter=") == 0)
+            simOptions.jitter_us = strtoll(arg.c_str() + 9, nullptr, 10);
+        else if (arg.compare(0, 7, "--drop=") == 0)
+            simOptions.dropRate = strtod(arg.c_str() + 7, nullptr);
+        else if (arg.compare(0, 8, "--flood=") == 0)
+            simOptions.floodRate = strtod(arg.c_str() + 8, nullptr);
+        else if (arg.compare(0, 11, "--restarts=") == 0)
+            restarts = atoi(arg.c_str() + 11);
+        else if (arg.compare(0, 14, "--reconfigure=") == 0 && arg.find('@') != std::string::npos)
+        {
+            size_t at      = arg.find('@');
+            reconfigParams = arg.substr(14, at - 14);
+            reconfigAt_us  = strtoll(arg.c_str() + at + 1, nullptr, 10) * 1000;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--messages=N] [--rate=msg/s] [--foreign=share]"
+                      << " [--params=extra,plugin,params] [--json=path]\n"
+                      << "       " << argv[0] << " --simulate [--duration=ms] [--basePeriod=us] [--jitter=us]"
+                      << " [--drop=p] [--flood=msg/s] [--restarts=N] [--reconfigure=params@ms] [--params=...] [--json=path]\n";
+            return 1;
+        }
+    }
+    if (simOptions.basePeriod_us <= 0)
+    {
+        std::cerr << "--basePeriod must be positive\n";
+        return 1;
+    }
+
+    // Simulated sensor joins the bus and runs first so it sees the
+    // configuration the plugin sends when it starts and answers its readbacks
+    dwSensorHandle_t simSensor = DW_NULL_HANDLE;
+    std::unique_ptr<SALCANTransport> simBus;
+    std::unique_ptr<OpenIMU300Simulator> simulator;
+    if (simulate)
+    {
+        dwSensorParams simParams = {"can.socket", "device=" HARNESS_BUS};
+        if (dwSAL_createSensor(&simSensor, simParams, DW_NULL_HANDLE) != DW_SUCCESS)
+            return 1;
+        simBus.reset(new SALCANTransport(simSensor));
+        simBus->start();
+        simulator.reset(new OpenIMU300Simulator(simBus.get(), simOptions));
+    }
+
+    HarnessResult result = {};
+    std::vector<dwCANMessage> trace;
+    std::atomic<bool> done(false);
+    std::thread producer;
+    auto start = std::chrono::steady_clock::now();
+
+    if (simulate)
+    {
+        producer = std::thread([&]() {
+            simulator->run(duration_us);
+            done = true;
+        });
+    }
+
+    dwSensorIMUPluginFunctionTable functions;
+    dwSensorIMUPlugin_getFunctionTable(&functions);
+
+    dwSensorPluginSensorHandle_t sensor = nullptr;
+    dwSensorPluginProperties properties;
+    std::string params = "can-proto=can.socket,device=" HARNESS_BUS;
+    if (!extraParams.empty())
+        params += "," + extraParams;
+
+    for (int run = 0; run <= (simulate ? restarts : 0); run++)
+    {
+        if (functions.common.createHandle(&sensor, &properties, params.c_str(), DW_NULL_HANDLE) != DW_SUCCESS ||
+            functions.common.createSensor(params.c_str(), DW_NULL_HANDLE, sensor) != DW_SUCCESS ||
+            functions.common.start(sensor) != DW_SUCCESS)
+        {
+            std::cerr << "Plugin setup failed for " << params << std::endl;
+            if (producer.joinable())
+            {
+                simulator->stop();
+                producer.join();
+            }
+            return 1;
+        }
+
+        configReport_t report;
+        if (simulate && dwSensorIMUPlugin_getConfigReport(IMU_ADDRESS, &report) == DW_SUCCESS)
+        {
+            printf("config: %u parameters, configured in %lld us, save %s\n", report.paramCount,
+                   static_cast<long long>(report.configured_us), configStatusName(report.save));
+            for (uint32_t i = 0; i < report.paramCount; i++)
+                printf("  %-20s %s, %u attempt(s)\n", report.params[i].name,
+                       configStatusName(report.params[i].status), report.params[i].attempts);
+        }
+
+        if (run < restarts)
+        {
+            functions.common.stop(sensor);
+            functions.common.release(sensor);
+        }
+    }
+
+    // Samples the simulator sent while the plugin configured it are read and
+    // dropped by the configuration, they do not count as transmitted
+    uint64_t sentDuringConfig = 0;
+    if (simulate)
+    {
+        sentDuringConfig = simulator->getStats().sent;
+    }
+    else
+    {
+        trace              = makeTrace(messages, 1.0 - foreign, 5);
+        result.transmitted = trace.size();
+        for (const auto& message : trace)
+            result.imuTransmitted += ((message.id & 0xFF) == IMU_ADDRESS);
+        result.latencies.reserve(result.imuTransmitted);
+        producer = std::thread(produce, std::cref(trace), rate, &done);
+    }
+
+    auto running = std::chrono::steady_clock::now();
+    while (true)
+    {
+        if (reconfigAt_us >= 0 && std::chrono::steady_clock::now() - running >= std::chrono::microseconds(reconfigAt_us))
+        {
+            dwStatus status = dwSensorIMUPlugin_reconfigure(IMU_ADDRESS, reconfigParams.c_str());
+            if (status != DW_SUCCESS)
+                std::cerr << "dwSensorIMUPlugin_reconfigure(" << reconfigParams << ") failed, " << status << std::endl;
+            reconfigAt_us = -1;
+        }
+
+        const uint8_t* data = nullptr;
+        size_t size         = 0;
+        dwStatus status     = functions.common.readRawData(&data, &size, nullptr, HARNESS_READ_TIMEOUT, sensor);
+        if (status != DW_SUCCESS)
+        {
+            if (done)
+                break;
+            continue;
+        }
+
+        size_t pushed = 0;
+        functions.common.pushData(&pushed, data, size, sensor);
+        functions.common.returnRawData(data, sensor);
+
+        dwIMUFrame frame;
+        size_t consumed = 0;
+        while ((status = functions.parseDataBuffer(&frame, &consumed, sensor)) != DW_NOT_AVAILABLE)
+        {
+            if (status == DW_SUCCESS)
+            {
+                result.latencies.push_back(dw::standin::VirtualCANBus::now() - frame.timestamp_us);
+                result.frames++;
+            }
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.seconds -= HARNESS_READ_TIMEOUT * 1e-6;    // Final idle read
+    producer.join();
+
+    reconfigStatus_t reconfig;
+    if (!reconfigParams.empty() && dwSensorIMUPlugin_getReconfigStatus(IMU_ADDRESS, &reconfig) == DW_SUCCESS)
+    {
+        static const char* stateNames[] = {"idle", "queued", "sent", "confirmed", "effective", "failed"};
+        printf("reconfigure: %s, confirmed after %lld us, new rate after %lld us (period %lld us)\n",
+               stateNames[reconfig.state], static_cast<long long>(reconfig.confirmed_us),
+               static_cast<long long>(reconfig.effective_us), static_cast<long long>(reconfig.period_us));
+        for (uint32_t i = 0; i < reconfig.paramCount; i++)
+            printf("  %-20s %s, %u attempt(s)\n", reconfig.params[i].name,
+                   configStatusName(reconfig.params[i].status), reconfig.params[i].attempts);
+    }
+
+    functions.common.stop(sensor);
+    functions.common.release(sensor);
+
+    if (simulate)
+    {
+        simulatorStats_t stats = simulator->getStats();
+        result.transmitted     = stats.sent + stats.flooded;
+        result.imuTransmitted  = stats.sent - sentDuringConfig;
+        printf("simulator: samples %llu, dropped %llu, flooded %llu, config applied %llu, readbacks %llu, "
+               "saves %llu, packetRate %u\n",
+               static_cast<unsigned long long>(stats.samples), static_cast<unsigned long long>(stats.dropped),
+               static_cast<unsigned long long>(stats.flooded), static_cast<unsigned long long>(stats.configApplied),
+               static_cast<unsigned long long>(stats.readbacks), static_cast<unsigned long long>(stats.saves),
+               simulator->getPacketRate());
+        simBus->stop();
+        simBus->release();
+    }
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+    printf("transmitted %zu (%zu IMU), frames %zu, %.0f frames/s\n", result.transmitted, result.imuTransmitted,
+           result.frames, result.frames / result.seconds);
+    printf("latency us: p50 %lld p90 %lld p99 %lld max %lld\n",
+           static_cast<long long>(percentile(result.latencies, 0.5)),
+           static_cast<long long>(percentile(result.latencies, 0.9)),
+           static_cast<long long>(percentile(result.latencies, 0.99)),
+           static_cast<long long>(result.latencies.empty() ? 0 : result.latencies.back()));
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, rate, foreign, result))
+    {
+        std::cerr << "Cannot write " << jsonPath << std::endl;
+        return 1;
+    }
+    // With --simulate, samples queued while the configuration finished may
+    // add a few frames
+    bool complete = simulate ? result.frames >= result.imuTransmitted : result.frames == result.imuTransmitted;
+    return complete ? 0 : 2;
+}
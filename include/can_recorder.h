@@ -0,0 +1,95 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef CAN_RECORDER_H_
+#define CAN_RECORDER_H_
+
+#include <dw/sensors/canbus/CAN.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CAN_RECORDER_MAGIC          "ACANREC\x01"   // File header, last byte is the format version
+#define CAN_RECORDER_MAGIC_SIZE     8
+#define CAN_RECORDER_BUFFER_SIZE    65536           // Bytes per buffer, two buffers are used
+#define CAN_RECORDER_FLUSH_US       500000          // Max time a record waits in memory
+#define CAN_RECORDER_ID_ESCAPE      0xFF            // Index byte followed by a literal 32 bit id
+#define CAN_RECORDER_MAX_RECORD     (10 + 1 + 4 + 1 + DW_SENSORS_CAN_MAX_MESSAGE_LEN)
+
+// Append-only compact recording of CAN messages, enabled with record=<path>.
+//
+// After the header each message is stored as
+//   timestamp   zigzag varint, difference to the previous message
+//   index       byte, position of the id in the id table, or
+//               CAN_RECORDER_ID_ESCAPE followed by the id (4 bytes, little
+//               endian) which is then appended to the table
+//   size        byte
+//   data        size bytes
+// The id table is rebuilt by the reader in the same order, so a periodic
+// 8 byte IMU message takes about 13 bytes instead of sizeof(dwCANMessage).
+//
+// record() only encodes into the active buffer. A background thread swaps
+// buffers and writes the full one, so the caller never waits on the disk.
+// Messages arriving while both buffers are full are dropped and counted.
+class CANRecorder
+{
+  public:
+    CANRecorder();
+
+    ~CANRecorder();
+
+    dwStatus open(const std::string &path);
+
+    // Writes pending records and closes the file
+    void close();
+
+    // Returns false if the message was dropped
+    bool record(const dwCANMessage &message);
+
+    uint64_t droppedCount() const
+    {
+      return dropped.load(std::memory_order_relaxed);
+    }
+
+    // Decodes a recording, e.g. a file mapped by the replay transport. A
+    // recording whose last record was cut short decodes up to that record,
+    // the number of bytes left over is returned in truncated.
+    static dwStatus decode(const uint8_t *data, size_t size, std::vector<dwCANMessage> *messages,
+                           size_t *truncated = nullptr);
+
+    static bool isRecording(const uint8_t *data, size_t size);
+
+  private:
+    size_t encode(const dwCANMessage &message, uint8_t *out);
+
+    void writerLoop();
+
+    FILE                          *file;
+    std::thread                   writer;
+    std::mutex                    lock;
+    std::condition_variable       signal;
+    bool                          running;
+    std::vector<uint8_t>          front;            // Filled by record()
+    std::vector<uint8_t>          back;             // Written by the writer thread
+    std::atomic<uint64_t>         dropped;
+
+    // Encoder state, only used by the recording thread
+    dwTime_t                      lastTimestamp;
+    std::vector<uint32_t>         ids;
+};
+
+#endif // CAN_RECORDER_H_
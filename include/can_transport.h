@@ -0,0 +1,85 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef CAN_TRANSPORT_H_
+#define CAN_TRANSPORT_H_
+
+#include <imu.h>
+
+// Source of CAN messages for the plugin. Selected with can-proto= in the
+// plugin parameter string.
+class CANTransport
+{
+  public:
+
+    virtual ~CANTransport(){};
+
+    virtual dwStatus start() = 0;
+
+    virtual dwStatus stop() = 0;
+
+    virtual dwStatus reset() = 0;
+
+    virtual dwStatus release() = 0;
+
+    virtual dwStatus readMessage(dwCANMessage *message, dwTime_t timeout_us) = 0;
+
+    virtual dwStatus sendMessage(const dwCANMessage *message, dwTime_t timeout_us) = 0;
+
+    // Restricts received messages to the given filters, DW_NOT_SUPPORTED if
+    // the transport cannot filter and every message must be checked by the caller.
+    virtual dwStatus setFilters(const canMessageFilter *filters, uint8_t count) = 0;
+
+    // Zero-copy read: points *message at storage owned by the transport.
+    // DW_NOT_SUPPORTED if the transport has no storage that outlives the call.
+    virtual dwStatus readMessageRef(const dwCANMessage **, dwTime_t)
+    {
+      return DW_NOT_SUPPORTED;
+    }
+
+    // True if message was handed out by readMessageRef()
+    virtual bool ownsMessage(const dwCANMessage *) const
+    {
+      return false;
+    }
+
+  private:
+};
+
+// Transport through a DriveWorks SAL CAN sensor, e.g. can-proto=can.socket
+class SALCANTransport : public CANTransport
+{
+  public:
+    SALCANTransport(dwSensorHandle_t canSensor);
+
+    virtual ~SALCANTransport() override;
+
+    virtual dwStatus start() override;
+
+    virtual dwStatus stop() override;
+
+    virtual dwStatus reset() override;
+
+    virtual dwStatus release() override;
+
+    virtual dwStatus readMessage(dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus sendMessage(const dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus setFilters(const canMessageFilter *filters, uint8_t count) override;
+
+  private:
+    dwSensorHandle_t              canSensor;
+};
+
+#endif // CAN_TRANSPORT_H_
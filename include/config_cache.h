@@ -0,0 +1,56 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef CONFIG_CACHE_H_
+#define CONFIG_CACHE_H_
+
+#include <imu.h>
+#include <string>
+
+#define CONFIG_CACHE_VERSION    1   // Part of the fingerprint, bump when configStep_t messages change meaning
+
+// FNV-1a over the configuration messages of the steps, in order. Identical
+// for identical parameters, PS remapping and source and IMU addresses.
+uint64_t configFingerprint(const configStep_t *steps, uint8_t count);
+
+// Host side record of the configuration last confirmed on each IMU, so a
+// restart with the same parameters does not have to configure it again.
+//
+// One line per IMU: "<bus> <imuAddress> <fingerprint>", the bus being the
+// can-proto= and device= of the sensor. The file is replaced as a whole
+// (written to a temporary file, then renamed), a reader never sees a partial
+// update. Only record a configuration that survives a power cycle of the IMU,
+// i.e. one saved to its non-volatile memory.
+class ConfigCache
+{
+  public:
+    explicit ConfigCache(const std::string &path)
+    : path(path)
+    { }
+
+    // True if the IMU on bus was last configured with fingerprint
+    bool contains(const std::string &bus, uint8_t imuAddress, uint64_t fingerprint) const;
+
+    // Records fingerprint for the IMU, replacing its previous entry
+    bool store(const std::string &bus, uint8_t imuAddress, uint64_t fingerprint);
+
+    // Drops the entry of the IMU, e.g. after a configuration that failed
+    bool erase(const std::string &bus, uint8_t imuAddress);
+
+  private:
+    bool update(const std::string &bus, uint8_t imuAddress, const uint64_t *fingerprint);
+
+    std::string path;
+};
+
+#endif // CONFIG_CACHE_H_
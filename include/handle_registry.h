@@ -0,0 +1,243 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef HANDLE_REGISTRY_H_
+#define HANDLE_REGISTRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Fixed capacity table of objects handed out through opaque handles.
+//
+// A handle encodes a slot index and the generation of the slot when the
+// object was added, so validating it is a single lookup no matter how many
+// objects are registered, and a handle of a removed object never matches
+// again even if its slot is reused. acquire() pins the object with a per
+// slot reference count, remove() invalidates the handle and waits until the
+// pinned references are gone before handing the object back for deletion.
+//
+// add() and remove() serialize on a mutex, acquire() is lock-free.
+// Capacity must be below 2^16.
+template <typename T, size_t Capacity>
+class HandleRegistry
+{
+    static_assert(Capacity != 0 && Capacity < 0xFFFF, "HandleRegistry capacity must fit in 16 bits");
+
+    static constexpr unsigned INDEX_BITS = 16;
+    static constexpr uintptr_t INDEX_MASK = (static_cast<uintptr_t>(1) << INDEX_BITS) - 1;
+
+    struct Slot
+    {
+      std::atomic<uintptr_t> generation;    // Odd while an object is registered
+      std::atomic<uint32_t>  refs;
+      std::atomic<T*>        object;
+    };
+
+  public:
+    // Pinned object, valid until the Ref is destroyed
+    class Ref
+    {
+      public:
+        Ref(Ref &&other)
+        : object(other.object)
+        , slot(other.slot)
+        {
+          other.slot = nullptr;
+        }
+
+        ~Ref()
+        {
+          if(slot != nullptr)
+            slot->refs.fetch_sub(1, std::memory_order_release);
+        }
+
+        explicit operator bool() const
+        {
+          return slot != nullptr;
+        }
+
+        T* operator->() const
+        {
+          return object;
+        }
+
+        T* get() const
+        {
+          return object;
+        }
+
+      private:
+        friend class HandleRegistry;
+
+        Ref(T *object, Slot *slot)
+        : object(object)
+        , slot(slot)
+        { }
+
+        Ref(const Ref&) = delete;
+        Ref& operator=(const Ref&) = delete;
+
+        T    *object;
+        Slot *slot;
+    };
+
+    HandleRegistry()
+    : freeCount(Capacity)
+    {
+      for(size_t i = 0; i < Capacity; i++)
+      {
+        slots[i].generation.store(0, std::memory_order_relaxed);
+        slots[i].refs.store(0, std::memory_order_relaxed);
+        slots[i].object.store(nullptr, std::memory_order_relaxed);
+        freeList[i] = Capacity - 1 - i;
+      }
+    }
+
+    // Deletes the objects that were never removed
+    ~HandleRegistry()
+    {
+      for(auto &slot : slots)
+      {
+        if(slot.generation.load(std::memory_order_relaxed) & 1)
+          delete slot.object.load(std::memory_order_relaxed);
+      }
+    }
+
+    // Takes ownership of object, returns nullptr if the table is full
+    void* add(T *object)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if(freeCount == 0)
+        return nullptr;
+
+      size_t index     = freeList[--freeCount];
+      Slot &slot       = slots[index];
+      uintptr_t gen    = slot.generation.load(std::memory_order_relaxed) + 1;
+      slot.object.store(object, std::memory_order_relaxed);
+      slot.generation.store(gen, std::memory_order_seq_cst);
+      return makeHandle(index, gen);
+    }
+
+    // Pins the object of handle, an empty Ref if the handle is not registered
+    Ref acquire(const void *handle)
+    {
+      uintptr_t value = reinterpret_cast<uintptr_t>(handle);
+      size_t index    = static_cast<size_t>(value & INDEX_MASK);
+      if(index == 0 || index > Capacity)
+        return Ref(nullptr, nullptr);
+
+      Slot &slot    = slots[index - 1];
+      uintptr_t gen = value >> INDEX_BITS;
+      if(!matches(slot, gen))
+        return Ref(nullptr, nullptr);
+
+      // Re-check after taking the reference, pairs with the invalidation in remove()
+      slot.refs.fetch_add(1, std::memory_order_seq_cst);
+      if(!matches(slot, gen))
+      {
+        slot.refs.fetch_sub(1, std::memory_order_release);
+        return Ref(nullptr, nullptr);
+      }
+      return Ref(slot.object.load(std::memory_order_acquire), &slot);
+    }
+
+    // Pins the first registered object for which match(object) is true.
+    // Scans every slot, meant for lookups outside the hot path.
+    template <typename Predicate>
+    Ref find(Predicate match)
+    {
+      size_t next = 0;
+      return findFrom(&next, match);
+    }
+
+    // Like find(), but the Ref is also empty if several objects match, then
+    // *ambiguous is set
+    template <typename Predicate>
+    Ref findUnique(Predicate match, bool *ambiguous)
+    {
+      size_t next = 0;
+      Ref ref     = findFrom(&next, match);
+      *ambiguous  = ref && findFrom(&next, match);
+      if(*ambiguous)
+        return Ref(nullptr, nullptr);
+      return ref;
+    }
+
+    // Invalidates handle, waits for outstanding Refs and returns the object,
+    // nullptr if the handle is not registered. The caller owns the object.
+    T* remove(const void *handle)
+    {
+      uintptr_t value = reinterpret_cast<uintptr_t>(handle);
+      size_t index    = static_cast<size_t>(value & INDEX_MASK);
+      if(index == 0 || index > Capacity)
+        return nullptr;
+
+      std::lock_guard<std::mutex> guard(lock);
+      Slot &slot    = slots[index - 1];
+      uintptr_t gen = value >> INDEX_BITS;
+      if(!matches(slot, gen))
+        return nullptr;
+
+      slot.generation.store(slot.generation.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+      while(slot.refs.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+      T *object = slot.object.exchange(nullptr, std::memory_order_relaxed);
+      freeList[freeCount++] = index - 1;
+      return object;
+    }
+
+  private:
+    // Scans the slots from *next on, leaves *next after the matching slot
+    template <typename Predicate>
+    Ref findFrom(size_t *next, Predicate match)
+    {
+      for(size_t i = *next; i < Capacity; i++)
+      {
+        uintptr_t gen = slots[i].generation.load(std::memory_order_acquire);
+        if(!(gen & 1))
+          continue;
+
+        Ref ref = acquire(makeHandle(i, gen));
+        if(ref && match(*ref.get()))
+        {
+          *next = i + 1;
+          return ref;
+        }
+      }
+      *next = Capacity;
+      return Ref(nullptr, nullptr);
+    }
+
+    static void* makeHandle(size_t index, uintptr_t gen)
+    {
+      return reinterpret_cast<void*>((gen << INDEX_BITS) | static_cast<uintptr_t>(index + 1));
+    }
+
+    // The handle only keeps the low bits of the generation
+    static bool matches(const Slot &slot, uintptr_t gen)
+    {
+      uintptr_t current = slot.generation.load(std::memory_order_seq_cst);
+      return (current & 1) && ((current << INDEX_BITS) >> INDEX_BITS) == gen;
+    }
+
+    Slot       slots[Capacity];
+    size_t     freeList[Capacity];
+    size_t     freeCount;
+    std::mutex lock;
+};
+
+#endif // HANDLE_REGISTRY_H_
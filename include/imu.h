@@ -11,12 +11,43 @@ See the License for the specific language governing permissions and
 limitations under the License.
 *******************************************************************************/
 
+#ifndef IMU_H_
+#define IMU_H_
+
 #include <iostream>
 #include <dw/sensors/canbus/CAN.h>
 #include <dw/sensors/imu/IMU.h>
 #include <algorithm>
 using namespace std;
 
+// CAN identifier filter, a message passes if (id & mask) == (filter.id & mask)
+typedef struct {
+  uint32_t id;
+  uint32_t mask;
+  bool     extended;    // 29-bit identifier
+} canMessageFilter;
+
+#define CONFIG_STEP_MAX_READBACKS   4
+
+// Answer that shows the sensor holds a setting. request is sent to ask for it,
+// size 0 if the sensor sends the answer by itself after the step's message.
+typedef struct {
+  dwCANMessage request;
+  uint32_t     responseId;        // Identifier of the answer, bits of responseMask compared
+  uint32_t     responseMask;
+  uint8_t      expected[8];       // Answer payload once the setting is applied, bytes of expectedMask compared
+  uint8_t      expectedMask[8];   // All zero if any answer confirms the setting
+} configReadback_t;
+
+// One configuration message and how to confirm the sensor applied it
+typedef struct {
+  dwCANMessage     message;
+  configReadback_t readbacks[CONFIG_STEP_MAX_READBACKS];
+  uint8_t          readbackCount;   // 0 if the setting cannot be read back
+  uint32_t         params;          // Bit i set if message carries parameter i, see getConfigParamName()
+  uint8_t          stage;           // Steps are sent stage by stage, in increasing order
+} configStep_t;
+
 class IMU
 {
   public:
@@ -27,9 +58,44 @@ class IMU
 
     virtual bool isValidMessage(uint32_t message_id) = 0;
 
-    virtual bool parseDataPacket(dwCANMessage packet, dwIMUFrame *IMUframe) = 0;
+    virtual bool parseDataPacket(const dwCANMessage &packet, dwIMUFrame *IMUframe) = 0;
 
     virtual void getSensorResetMessage(dwCANMessage *packet) = 0;
 
+    // Filters matching exactly the messages accepted by isValidMessage(), valid after init()
+    virtual uint8_t getMessageFilters(canMessageFilter *filters, uint8_t maxFilters) = 0;
+
+    // Configuration of the parameters given to init(), in send order, valid after init()
+    virtual uint8_t getConfigSteps(configStep_t *steps, uint8_t maxSteps) = 0;
+
+    // Name of parameter i of configStep_t::params, nullptr if there is none
+    virtual const char* getConfigParamName(uint8_t param) = 0;
+
+    // Step that stores the current configuration in the sensor's non-volatile
+    // memory, false if the sensor has none
+    virtual bool getSaveConfigStep(configStep_t *step) = 0;
+
+    // Steps changing parameters while the sensor streams, paramsString in the
+    // format of init(). *count is the room in steps on entry. *newPeriod_us is
+    // the data period once applied, negative if the period does not change.
+    // Called from any thread, false if a parameter cannot be changed this way.
+    virtual bool getRuntimeConfigSteps(string paramsString, configStep_t *steps, uint8_t *count,
+                                       dwTime_t *newPeriod_us) = 0;
+
+    // Data period the sensor sends at, once a runtime change is observed on
+    // the bus. Called from the reading thread while frames are decoded.
+    virtual void setDataPeriod(dwTime_t period_us) = 0;
+
+    // Data period the sensor sends at, as configured or last set with
+    // setDataPeriod(). Called from any thread.
+    virtual dwTime_t getDataPeriod() const = 0;
+
+    // Ends the change of the last getRuntimeConfigSteps(). params has the bits
+    // of configStep_t::params of the steps the sensor confirmed, only those
+    // values are kept for the following changes.
+    virtual void commitRuntimeConfig(uint32_t params) = 0;
+
   private:
 };
+
+#endif // IMU_H_
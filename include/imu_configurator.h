@@ -0,0 +1,187 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef IMU_CONFIGURATOR_H_
+#define IMU_CONFIGURATOR_H_
+
+#include <can_transport.h>
+#include <imu.h>
+#include <imu_plugin_config.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#define CONFIG_MAX_STEPS            16
+#define CONFIG_SEND_TIMEOUT_US      100000    // Per message, same as the plugin used before readback
+#define CONFIG_READBACK_TIMEOUT_US  50000     // Wait for the readback answers of one attempt
+#define CONFIG_MAX_ATTEMPTS         3
+
+#define RECONFIG_SEND_TIMEOUT_US    1000      // Per message, the reading thread must not stall on a busy bus
+#define RECONFIG_RATE_INTERVALS     3         // Consecutive packet intervals at the new period to call it effective
+#define RECONFIG_RATE_TOLERANCE     4         // An interval matches within period / RECONFIG_RATE_TOLERANCE,
+                                              // and closer to the new period than to the old one
+#define RECONFIG_RATE_TIMEOUT_US    2000000   // Stop watching for the new rate after this long (plus 10 periods)
+#define RECONFIG_TRACKED_IDS        4         // Data PGNs whose spacing is watched
+
+typedef struct{
+  configStatus_t status;
+  uint32_t       attempts;    // Times the message was sent
+}configStepResult_t;
+
+// Short description of status for messages, e.g. "no response"
+const char* configStatusName(configStatus_t status);
+
+// Sends the configuration steps of an IMU and confirms them by readback.
+//
+// Steps are sent stage by stage. Within a stage all messages are sent back to
+// back, then all readback requests, then the answers are collected in
+// whatever order they arrive, so a stage costs about one round trip instead
+// of one per message. Steps that were not confirmed (no answer, or another
+// value) are sent again, up to maxAttempts times. Other traffic read while
+// waiting for answers is dropped, the configuration runs before streaming.
+//
+// With onlyChanges, the readbacks of all steps are first requested at once and
+// steps whose settings the sensor already holds are not sent.
+class IMUConfigurator
+{
+  public:
+    IMUConfigurator(CANTransport *transport, bool verify = true,
+                    dwTime_t readbackTimeout_us = CONFIG_READBACK_TIMEOUT_US,
+                    uint32_t maxAttempts = CONFIG_MAX_ATTEMPTS)
+    : transport(transport)
+    , verify(verify)
+    , readbackTimeout_us(readbackTimeout_us)
+    , maxAttempts(maxAttempts)
+    { }
+
+    // Fills results[i] for steps[i]. Returns DW_FAILURE if a message could
+    // not be sent, a step that was sent but not confirmed is only reported.
+    dwStatus run(const configStep_t *steps, uint8_t count, configStepResult_t *results, bool onlyChanges = false);
+
+  private:
+    typedef enum{
+      READBACK_MATCH,       // Every readback answered with the expected values
+      READBACK_MISMATCH,    // A readback answered with other values
+      READBACK_MISSING,     // A readback was not answered in time
+    }readbackOutcome_t;
+
+    // Requests the readbacks of the steps with ask[i] and waits for the answers
+    void readBack(const configStep_t *steps, uint8_t count, const bool *ask, readbackOutcome_t *outcomes);
+
+    // Clears send[i] of the steps the sensor already holds
+    void probe(const configStep_t *steps, uint8_t count, bool *send, configStepResult_t *results);
+
+    // Sends the steps of one stage, pending[i] tells which ones
+    void runStage(const configStep_t *steps, uint8_t count, bool *pending, configStepResult_t *results);
+
+    CANTransport  *transport;
+    bool           verify;
+    dwTime_t       readbackTimeout_us;
+    uint32_t       maxAttempts;
+};
+
+//----------------------------------------------------------------------------//
+
+// Configuration changes while the sensor streams.
+//
+// Any thread submits a change. The thread reading the bus calls service()
+// before each read and filter() on each IMU message it reads. service() sends
+// the queued steps and their readback requests, and sends them again when
+// the readback times out. filter() takes the readback answers out of the
+// stream and watches the spacing of the data packets until it matches the new
+// period. Then the decoder's period is updated with IMU::setDataPeriod().
+// Nothing blocks the reading thread longer than RECONFIG_SEND_TIMEOUT_US per
+// message, and when no change is in progress both calls are a single atomic
+// load.
+class RuntimeConfigurator
+{
+  public:
+    RuntimeConfigurator(dwTime_t readbackTimeout_us = CONFIG_READBACK_TIMEOUT_US,
+                        uint32_t maxAttempts = CONFIG_MAX_ATTEMPTS);
+
+    // Queues the steps of imu, newPeriod_us as from IMU::getRuntimeConfigSteps().
+    // DW_NOT_READY while the previous change is queued or sent.
+    dwStatus submit(IMU *imu, const configStep_t *steps, uint8_t count, dwTime_t newPeriod_us);
+
+    // Drops a change in progress, e.g. when the sensor stops
+    void cancel();
+
+    // True while a change is queued or sent
+    bool busy() const;
+
+    void service(CANTransport *transport)
+    {
+      if(active.load(std::memory_order_acquire))
+        serviceLocked(transport);
+    }
+
+    // True if message was the answer to a readback and must not be decoded
+    bool filter(const dwCANMessage &message)
+    {
+      return active.load(std::memory_order_acquire) && filterLocked(message);
+    }
+
+    void getStatus(reconfigStatus_t *status) const;
+
+    // Receive timestamp of the readback answer that confirmed the last change,
+    // 0 before any. Data packets after it follow the new settings.
+    dwTime_t getConfirmedTimestamp() const
+    {
+      return confirmedTimestamp_us.load(std::memory_order_acquire);
+    }
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    typedef struct{
+      uint32_t id;
+      dwTime_t last_us;         // Receive time of the last packet
+      uint32_t matching;        // Consecutive intervals at the new period
+      dwTime_t first_us;        // Receive time of the first packet at the new period
+    }trackedId_t;
+
+    void serviceLocked(CANTransport *transport);
+    bool filterLocked(const dwCANMessage &message);
+    void sendPending(CANTransport *transport);
+    void finishAttempt();
+    void commitConfirmed();
+    void trackRate(const dwCANMessage &message);
+    void setState(reconfigState_t state);
+    dwTime_t sinceSubmit() const;
+
+    dwTime_t                readbackTimeout_us;
+    uint32_t                maxAttempts;
+
+    mutable std::mutex      lock;
+    std::atomic<bool>       active;       // service() or filter() have work
+    std::atomic<dwTime_t>   confirmedTimestamp_us;
+    dwTime_t                lastAnswer_us;  // Receive timestamp of the last readback answer
+    IMU                     *imu;
+    configStep_t            steps[CONFIG_MAX_STEPS];
+    configStepResult_t      results[CONFIG_MAX_STEPS];
+    uint8_t                 count;
+    bool                    pending[CONFIG_MAX_STEPS];      // Not confirmed yet
+    bool                    awaiting[CONFIG_MAX_STEPS][CONFIG_STEP_MAX_READBACKS];
+    bool                    mismatch[CONFIG_MAX_STEPS];
+    uint8_t                 paramStep[CONFIG_REPORT_MAX_PARAMS];    // Step of status.params[i]
+    reconfigStatus_t        status;
+    clock::time_point       submitted;
+    clock::time_point       deadline;     // End of the current readback attempt
+    clock::time_point       rateDeadline; // Stop watching the packet spacing
+    dwTime_t                oldPeriod_us; // Data period before the change
+    bool                    rateSeen;     // New period observed, possibly before the readback
+    trackedId_t             tracked[RECONFIG_TRACKED_IDS];
+    uint8_t                 trackedCount;
+};
+
+#endif // IMU_CONFIGURATOR_H_
@@ -0,0 +1,162 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef IMU_FRAME_ASSEMBLER_H_
+#define IMU_FRAME_ASSEMBLER_H_
+
+#include <dw/sensors/imu/IMU.h>
+#include <limits>
+
+#define FRAME_ASSEMBLER_DEFAULT_TIMEOUT_US    5000
+
+// Merges the partial dwIMUFrames decoded from individual CAN packets
+// (angular rate, acceleration, magnetometer, slope) into one frame per sample
+// epoch.
+//
+// An epoch is closed when
+//  - all parts seen in previous epochs have arrived,
+//  - a part arrives that is already present in the epoch (next sample), or
+//  - a part arrives more than timeout_us after the first part of the epoch, or
+//  - flushExpired() is called more than timeout_us after the epoch was opened,
+//    so a partial epoch is not held back once the stream goes idle.
+// The set of expected parts is learned from the stream, so the assembler does
+// not need to know the packetType the IMU was configured with. After the
+// packetType changes, relearn() starts over from the epochs after the change.
+class IMUFrameAssembler
+{
+  public:
+    IMUFrameAssembler()
+    : m_timeout_us(FRAME_ASSEMBLER_DEFAULT_TIMEOUT_US)
+    {
+      reset();
+    }
+
+    void setTimeout(dwTime_t timeout_us)
+    {
+      m_timeout_us = timeout_us;
+    }
+
+    void reset()
+    {
+      m_pending       = {};
+      m_openedAt_us   = 0;
+      m_expectedFlags = 0;
+      m_learnAfter_us = std::numeric_limits<dwTime_t>::min();
+      m_readyCount    = 0;
+    }
+
+    // Forgets the expected parts, they are learned again from the epochs
+    // starting after since_us. Older epochs still queued, with parts the
+    // IMU no longer sends, do not count.
+    void relearn(dwTime_t since_us)
+    {
+      m_expectedFlags = 0;
+      m_learnAfter_us = since_us;
+    }
+
+    // Adds a partial frame received at local time now_us. Completed frames
+    // are retrieved with next().
+    void add(const dwIMUFrame &part, dwTime_t now_us)
+    {
+      if(m_pending.flags != 0)
+      {
+        bool duplicate = (m_pending.flags & part.flags) != 0;
+        bool expired   = (part.timestamp_us - m_pending.timestamp_us) > m_timeout_us;
+        if(duplicate || expired)
+        {
+          emit();
+        }
+      }
+
+      if(m_pending.flags == 0)
+      {
+        m_pending.timestamp_us = part.timestamp_us;
+        m_openedAt_us          = now_us;
+      }
+      merge(part);
+
+      if(m_expectedFlags != 0 && (m_pending.flags & m_expectedFlags) == m_expectedFlags)
+      {
+        emit();
+      }
+    }
+
+    // Closes the pending epoch if it was opened more than timeout_us before
+    // local time now_us. Called when no more parts are queued.
+    void flushExpired(dwTime_t now_us)
+    {
+      if(m_pending.flags != 0 && now_us - m_openedAt_us > m_timeout_us)
+      {
+        emit();
+      }
+    }
+
+    // Returns the oldest completed frame, if any.
+    bool next(dwIMUFrame *frame)
+    {
+      if(m_readyCount == 0)
+        return false;
+
+      *frame = m_ready[0];
+      m_ready[0] = m_ready[1];
+      m_readyCount--;
+      return true;
+    }
+
+  private:
+    void emit()
+    {
+      if(m_readyCount == 2)
+      {
+        // Consumer did not drain, drop the oldest completed frame
+        m_ready[0] = m_ready[1];
+        m_readyCount--;
+      }
+      if(m_pending.timestamp_us > m_learnAfter_us)
+        m_expectedFlags |= m_pending.flags;
+      m_ready[m_readyCount++] = m_pending;
+      m_pending = {};
+    }
+
+    void merge(const dwIMUFrame &part)
+    {
+      static const uint32_t orientationFlags[3]  = {DW_IMU_ROLL, DW_IMU_PITCH, DW_IMU_YAW};
+      static const uint32_t turnrateFlags[3]     = {DW_IMU_ROLL_RATE, DW_IMU_PITCH_RATE, DW_IMU_YAW_RATE};
+      static const uint32_t accelerationFlags[3] = {DW_IMU_ACCELERATION_X, DW_IMU_ACCELERATION_Y, DW_IMU_ACCELERATION_Z};
+      static const uint32_t magnetometerFlags[3] = {DW_IMU_MAGNETOMETER_X, DW_IMU_MAGNETOMETER_Y, DW_IMU_MAGNETOMETER_Z};
+
+      for(int i = 0; i < 3; i++)
+      {
+        if(part.flags & orientationFlags[i])
+          m_pending.orientation[i] = part.orientation[i];
+        if(part.flags & turnrateFlags[i])
+          m_pending.turnrate[i] = part.turnrate[i];
+        if(part.flags & accelerationFlags[i])
+          m_pending.acceleration[i] = part.acceleration[i];
+        if(part.flags & magnetometerFlags[i])
+          m_pending.magnetometer[i] = part.magnetometer[i];
+      }
+
+      m_pending.flags |= part.flags;
+    }
+
+    dwTime_t      m_timeout_us;       // Max time between first and last part of an epoch
+    dwIMUFrame    m_pending;          // Epoch being assembled
+    dwTime_t      m_openedAt_us;      // Local time the first part of the pending epoch was added
+    uint32_t      m_expectedFlags;    // Union of parts seen in closed epochs
+    dwTime_t      m_learnAfter_us;    // Epochs starting before this are not learned from
+    dwIMUFrame    m_ready[2];         // Completed epochs, an add() can close at most two
+    uint8_t       m_readyCount;
+};
+
+#endif // IMU_FRAME_ASSEMBLER_H_
@@ -0,0 +1,106 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef IMU_PLUGIN_CONFIG_H_
+#define IMU_PLUGIN_CONFIG_H_
+
+// Sensor configuration functions exported by the plugin library next to
+// dwSensorIMUPlugin_getFunctionTable. Like the statistics in
+// imu_plugin_stats.h, sensors are looked up by the J1939 address of their
+// IMU (imuAddress=), and DW_FAILURE means sensors on several buses decode
+// that address.
+
+#include <dw/core/Types.h>
+#include <stdint.h>
+
+#define CONFIG_REPORT_MAX_PARAMS    16
+
+// Outcome of one configuration parameter
+typedef enum
+{
+  CONFIG_NOT_SENT,          // Not sent yet, or configVerify= left it out
+  CONFIG_VERIFIED,          // Read back from the IMU with the requested value
+  CONFIG_UNVERIFIED,        // Sent, the IMU has no readback for this parameter
+  CONFIG_MISMATCH,          // Read back with a different value after all attempts
+  CONFIG_NO_RESPONSE,       // The IMU did not answer the readback after all attempts
+  CONFIG_SEND_FAILED,       // The message could not be sent
+  CONFIG_UNCHANGED,         // Already set on the IMU, not sent (configDiff=)
+  CONFIG_CACHED,            // Same configuration as the cached one, not sent (configCache=)
+} configStatus_t;
+
+typedef struct
+{
+  const char     *name;     // Parameter key, e.g. "packetRate"
+  configStatus_t  status;
+  uint32_t        attempts; // Times the parameter was sent
+} configParamReport_t;
+
+typedef struct
+{
+  configParamReport_t params[CONFIG_REPORT_MAX_PARAMS];
+  uint32_t            paramCount;       // Parameters given to the plugin
+  dwTime_t            configured_us;    // From start of the sensor to the end of the configuration
+  dwTime_t            streaming_us;     // From start of the sensor to the first decoded frame, 0 until then
+  configStatus_t      save;             // Save to the IMU's non-volatile memory, CONFIG_NOT_SENT without configSave=
+} configReport_t;
+
+// Progress of a runtime change, see dwSensorIMUPlugin_reconfigure()
+typedef enum
+{
+  RECONFIG_IDLE,            // Nothing requested since the sensor started
+  RECONFIG_QUEUED,          // Accepted, waiting for the next read of the bus to send it
+  RECONFIG_SENT,            // Sent, waiting for the readback
+  RECONFIG_CONFIRMED,       // Read back, waiting for data packets at the new packetRate
+  RECONFIG_EFFECTIVE,       // Read back and, for a packetRate change, observed on the bus
+  RECONFIG_FAILED,          // A parameter was not confirmed, see params
+} reconfigState_t;
+
+typedef struct
+{
+  reconfigState_t     state;
+  uint32_t            sequence;         // Number of changes accepted since the sensor was created
+  configParamReport_t params[CONFIG_REPORT_MAX_PARAMS];
+  uint32_t            paramCount;
+  dwTime_t            confirmed_us;     // From the request to the last readback, 0 until then
+  dwTime_t            effective_us;     // From the request to the first packet at the new rate, 0 until then
+  dwTime_t            effectiveTimestamp_us;  // Receive time of that packet, frames from then on come at the new rate
+  dwTime_t            period_us;        // Data period requested by the change, -1 if packetRate was not changed
+} reconfigStatus_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configuration of the sensor of the IMU at imuAddress at its last start.
+// DW_INVALID_ARGUMENT if no sensor of the process decodes that address.
+dwStatus dwSensorIMUPlugin_getConfigReport(uint8_t imuAddress, configReport_t *report);
+
+// Changes parameters of a started sensor without stopping it, params in the
+// format of the parameter string, e.g. "packetRate=1,rateLPF=25". Only
+// packetRate, packetType, orientation, rateLPF and accelLPF can be changed.
+// The values are validated here and sent by the next read of the bus
+// (readRawData, or the reader thread with readerThread=1), frames keep coming
+// meanwhile. Follow the change with dwSensorIMUPlugin_getReconfigStatus().
+// DW_INVALID_ARGUMENT for an unknown address or an invalid parameter,
+// DW_CALL_NOT_ALLOWED if the sensor is not started or cannot send (replay),
+// DW_NOT_READY while the previous change is still queued or sent.
+dwStatus dwSensorIMUPlugin_reconfigure(uint8_t imuAddress, const char *params);
+
+// Progress of the last change requested with dwSensorIMUPlugin_reconfigure()
+dwStatus dwSensorIMUPlugin_getReconfigStatus(uint8_t imuAddress, reconfigStatus_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMU_PLUGIN_CONFIG_H_
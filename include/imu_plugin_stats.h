@@ -0,0 +1,83 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef IMU_PLUGIN_STATS_H_
+#define IMU_PLUGIN_STATS_H_
+
+// Statistics exported by the plugin library next to
+// dwSensorIMUPlugin_getFunctionTable. Sensors are looked up by the J1939
+// address of their IMU (imuAddress=) since applications only hold the
+// DriveWorks sensor handle, not the plugin's. When sensors on several buses
+// decode the same address the lookup fails with DW_FAILURE rather than pick
+// one of them.
+
+#include <dw/core/Types.h>
+#include <stdint.h>
+
+#define LATENCY_HISTOGRAM_BUCKETS   32  // Bucket i counts durations in [2^(i-1), 2^i) ns, bucket 0 is 0 ns
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+  uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];  // Last bucket also counts longer durations
+} latencyHistogram_t;
+
+// Stages of the plugin timed when built with ENABLE_PLUGIN_STATS
+typedef enum
+{
+  PLUGIN_STAGE_CAN_READ,    // One read from the CAN transport
+  PLUGIN_STAGE_FILTER,      // isValidMessage() of one message
+  PLUGIN_STAGE_PUSH,        // One pushData call
+  PLUGIN_STAGE_PARSE,       // One decode of a single message
+  PLUGIN_STAGE_EMIT,        // One parseDataBuffer call that returned a frame
+  PLUGIN_STAGE_COUNT,
+} pluginStage_t;
+
+#define PLUGIN_STATS_MAX_PGNS       16  // Distinct PGNs counted per sensor
+
+typedef struct
+{
+  uint32_t pgn;
+  uint64_t messages;          // Messages of this PGN given to the decoder
+  uint64_t decodeFailures;    // Of which the decoder rejected
+} pgnStats_t;
+
+typedef struct
+{
+  latencyHistogram_t stages[PLUGIN_STAGE_COUNT];
+  pgnStats_t         pgns[PLUGIN_STATS_MAX_PGNS];
+  uint32_t           pgnCount;
+  uint64_t           otherMessages;   // Messages of PGNs beyond the table
+} pluginStats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Time spent in readRawData by the sensor of the IMU at imuAddress.
+// DW_INVALID_ARGUMENT if no sensor of the process decodes that address,
+// DW_FAILURE if several do.
+dwStatus dwSensorIMUPlugin_getReadLatency(uint8_t imuAddress, latencyHistogram_t *histogram);
+
+// Per-stage latency and per-PGN counters of the sensor of the IMU at imuAddress.
+// DW_INVALID_ARGUMENT and DW_FAILURE as above, DW_NOT_SUPPORTED if the plugin
+// was built without ENABLE_PLUGIN_STATS.
+dwStatus dwSensorIMUPlugin_getStats(uint8_t imuAddress, pluginStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMU_PLUGIN_STATS_H_
@@ -0,0 +1,91 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <imu_plugin_stats.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Power of two histogram of durations in nanoseconds.
+//
+// record() is a few relaxed atomic increments, so one thread can record while
+// others take snapshots. Percentiles are only resolved to a bucket, i.e. to
+// within a factor of two, which is enough to see where a latency tail starts.
+class LatencyHistogram
+{
+  public:
+    LatencyHistogram()
+    {
+      reset();
+    }
+
+    void record(uint64_t ns)
+    {
+      count.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(ns, std::memory_order_relaxed);
+      buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+
+      uint64_t current = max.load(std::memory_order_relaxed);
+      while(ns > current && !max.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+      { }
+    }
+
+    void snapshot(latencyHistogram_t *histogram) const
+    {
+      histogram->count  = count.load(std::memory_order_relaxed);
+      histogram->sum_ns = sum.load(std::memory_order_relaxed);
+      histogram->max_ns = max.load(std::memory_order_relaxed);
+      for(size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        histogram->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+      count.store(0, std::memory_order_relaxed);
+      sum.store(0, std::memory_order_relaxed);
+      max.store(0, std::memory_order_relaxed);
+      for(auto &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the p-quantile, 0 if nothing was recorded
+    static uint64_t percentile(const latencyHistogram_t &histogram, double p)
+    {
+      uint64_t rank = static_cast<uint64_t>(p * histogram.count + 0.5);
+      uint64_t seen = 0;
+      for(size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+      {
+        seen += histogram.buckets[i];
+        if(seen >= rank && seen > 0)
+          return i == LATENCY_HISTOGRAM_BUCKETS - 1 ? histogram.max_ns : (static_cast<uint64_t>(1) << i);
+      }
+      return histogram.max_ns;
+    }
+
+  private:
+    static size_t bucketOf(uint64_t ns)
+    {
+      size_t bucket = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+      return bucket < LATENCY_HISTOGRAM_BUCKETS ? bucket : LATENCY_HISTOGRAM_BUCKETS - 1;
+    }
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[LATENCY_HISTOGRAM_BUCKETS];
+};
+
+#endif // LATENCY_HISTOGRAM_H_
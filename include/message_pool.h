@@ -0,0 +1,166 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef MESSAGE_POOL_H_
+#define MESSAGE_POOL_H_
+
+#include <imu.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#define MESSAGE_POOL_WAIT_MIN_US    10      // First sleep of wait() when no slot is free
+#define MESSAGE_POOL_WAIT_MAX_US    500     // Longest sleep between two attempts of wait()
+#define MESSAGE_POOL_NO_SLOT        0xFFFFFFFFu
+
+// Fixed set of CAN message slots passed by pointer from readRawData through
+// pushData to parseData.
+//
+// Each slot is reference counted: get() hands it out with one reference for
+// the caller of readRawData, pushData adds one while the slot is queued for
+// parsing, and returnRawData and parseData drop theirs. The slot is free
+// again once the last reference is dropped, in whatever order that happens.
+//
+// Free slots are kept on a lock-free stack of slot indices, so get() and
+// release() take no lock whichever threads call them. The head carries a
+// counter next to the index so a pop cannot succeed on a head that was popped
+// and pushed again in between (ABA). Last in, first out keeps the slots in
+// use few and warm in the cache.
+class MessagePool
+{
+  public:
+    MessagePool(size_t size)
+    : slots(new Slot[size])
+    , slotCount(size)
+    , freeHead(MESSAGE_POOL_NO_SLOT)
+    {
+      for(size_t i = size; i-- > 0;)
+      {
+        slots[i].refs.store(0, std::memory_order_relaxed);
+        pushFree(static_cast<uint32_t>(i));
+      }
+    }
+
+    // Free slot with one reference, nullptr if every slot is in use
+    dwCANMessage* get()
+    {
+      uint64_t head = freeHead.load(std::memory_order_acquire);
+      while(true)
+      {
+        uint32_t index = static_cast<uint32_t>(head);
+        if(index == MESSAGE_POOL_NO_SLOT)
+          return nullptr;
+
+        // next may be stale if another thread popped the slot meanwhile, the
+        // counter in head then makes the exchange fail
+        uint64_t next = (head & ~uint64_t(0xFFFFFFFF)) + (uint64_t(1) << 32) +
+                        slots[index].nextFree.load(std::memory_order_relaxed);
+        if(freeHead.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+        {
+          slots[index].refs.store(1, std::memory_order_relaxed);
+          return &slots[index].message;
+        }
+      }
+    }
+
+    // Same as get(), waits up to timeout_us for a slot to be released. Polls
+    // with a growing sleep so release() does not have to signal waiters.
+    dwCANMessage* wait(dwTime_t timeout_us)
+    {
+      dwCANMessage *message = get();
+      if(message != nullptr || timeout_us == 0)
+        return message;
+
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+      dwTime_t sleep_us = MESSAGE_POOL_WAIT_MIN_US;
+      while((message = get()) == nullptr)
+      {
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(left <= 0)
+          break;
+        std::this_thread::sleep_for(std::chrono::microseconds(std::min<dwTime_t>(sleep_us, left)));
+        sleep_us = std::min<dwTime_t>(sleep_us * 2, MESSAGE_POOL_WAIT_MAX_US);
+      }
+      return message;
+    }
+
+    bool owns(const dwCANMessage *message) const
+    {
+      const uint8_t *first = reinterpret_cast<const uint8_t*>(slots.get());
+      const uint8_t *byte  = reinterpret_cast<const uint8_t*>(message);
+      return byte >= first && byte < first + slotCount * sizeof(Slot) &&
+             static_cast<size_t>(byte - first) % sizeof(Slot) == 0;
+    }
+
+    void addRef(const dwCANMessage *message)
+    {
+      toSlot(message)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drops one reference, returns false if message is not a slot of this pool
+    // or the slot is already free, e.g. returned twice
+    bool release(const dwCANMessage *message)
+    {
+      if(!owns(message))
+        return false;
+
+      Slot *slot    = toSlot(message);
+      uint32_t refs = slot->refs.load(std::memory_order_relaxed);
+      do
+      {
+        if(refs == 0)
+          return false;
+      } while(!slot->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+      if(refs == 1)
+        pushFree(static_cast<uint32_t>(slot - slots.get()));
+      return true;
+    }
+
+    size_t size() const
+    {
+      return slotCount;
+    }
+
+  private:
+    struct Slot
+    {
+      dwCANMessage          message;    // First member, a message pointer is a slot pointer
+      std::atomic<uint32_t> refs;
+      std::atomic<uint32_t> nextFree;   // Index of the slot below on the free stack
+    };
+
+    void pushFree(uint32_t index)
+    {
+      uint64_t head = freeHead.load(std::memory_order_relaxed);
+      uint64_t next;
+      do
+      {
+        slots[index].nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        next = (head & ~uint64_t(0xFFFFFFFF)) + (uint64_t(1) << 32) + index;
+      } while(!freeHead.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Slot* toSlot(const dwCANMessage *message) const
+    {
+      return const_cast<Slot*>(reinterpret_cast<const Slot*>(message));
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t                  slotCount;
+    std::atomic<uint64_t>   freeHead;     // Change counter (high half), index of the top free slot (low half)
+};
+
+#endif // MESSAGE_POOL_H_
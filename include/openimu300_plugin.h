@@ -11,7 +11,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 *******************************************************************************/
 
+#ifndef OPENIMU300_PLUGIN_H_
+#define OPENIMU300_PLUGIN_H_
+
 #include <imu.h>
+#include <sample_clock_estimator.h>
+#include <atomic>
+#include <mutex>
 using namespace std;
 
 typedef enum{
@@ -70,55 +76,25 @@ typedef enum{
   PARAM_MAX_PARAMS,
 } IMUPARAM_t;
 
-// angular rate data payload format
-typedef struct {
-    uint16_t roll_rate;                             // roll  rate
-    uint16_t pitch_rate;                            // pitch rate
-    uint16_t yaw_rate;                              // yaw   rate
-    uint8_t  pitch_merit          :       2;        // pitch rate merit
-    uint8_t  roll_merit           :       2;        // roll  rate merit
-    uint8_t  yaw_merit            :       2;        // yaw  rate merit
-    uint8_t  rsvd                 :       2;        // rsvd
-    uint8_t  measurement_latency;                   // latency
-} angularRate;
-
-// accleration data payload format
-typedef struct {
-    uint16_t   acceleration_x;                      // x-axis acceleration
-    uint16_t   acceleration_y;                      // y-axis acceleration
-    uint16_t   acceleration_z;                      // z-axis acceleration
-    uint8_t    lateral_merit        :       2;      // laterar acc merit
-    uint8_t    longitudinal_merit   :       2;      // longitudinal merit
-    uint8_t    vertical_merit       :       2;      // vertical merit
-    uint8_t    transmit_rate        :       2;      // repetition rate
-    uint8_t    rsvd;
-} accelSensor;
-
-// accleration data payload format
-typedef struct {
-    uint16_t   mag_x;                        // x-axis mag data
-    uint16_t   mag_y;                        // y-axis mag data
-    uint16_t   mag_z;                        // z-axis mag data
-    uint16_t   unuzed;
-} magSensor;
-
-// slope sensor data payload format
-typedef struct {
-    uint64_t pitch                :       24;       // pitch
-    uint64_t roll                 :       24;       // roll
-    uint64_t pitch_compensation   :       2;        // pitch compensation
-    uint64_t pitch_merit          :       2;        // pitch merit
-    uint64_t roll_compensation    :       2;        // roll compensation
-    uint64_t roll_merit           :       2;        // roll merit
-    uint64_t measure_latency      :       8;        // latency
-} slopeSensor;
+// Options of the parameter string used by the decoder, numbered after IMUPARAM_t
+typedef enum{
+  OPTION_LATENCY_COMPENSATION = PARAM_MAX_PARAMS,
+  OPTION_CAN_BITRATE,
+  OPTION_MAX_KEYS,
+} IMUOPTION_t;
+
+// Values found in the parameter string, indexed by IMUPARAM_t and IMUOPTION_t
+typedef struct{
+  uint32_t value[OPTION_MAX_KEYS];
+  bool     given[OPTION_MAX_KEYS];
+} paramValues_t;
 
 struct pgn{
   PACKET_TYPE_t type;
   uint8_t PF;
   uint8_t PS;
   pgn(){type = NONE, PF = 0; PS = 0;}
-  pgn(PACKET_TYPE_t type, uint8_t pf, uint8_t ps): type(type), PF(pf), PS(ps){}
+  constexpr pgn(PACKET_TYPE_t type, uint8_t pf, uint8_t ps): type(type), PF(pf), PS(ps){}
 };
 
 typedef struct{
@@ -130,6 +106,13 @@ typedef struct{
   uint8_t resetAlgo;
 } imuParameters_t;
 
+#define IMU_BASE_PERIOD_US    10000   // packetRate divides the 100Hz base output rate
+#define IMU_LATENCY_UNIT_US   500     // J1939 measurement latency resolution, 0.5ms/bit
+#define CAN_DEFAULT_BITRATE   250000  // bit/s
+
+#define PGN_LOOKUP_MAX_PF     8       // Max number of distinct PF values in IMU300pgnList
+#define PGN_LOOKUP_INVALID    0xFF    // Marks an unused PF row / (PF, PS) entry in the lookup table
+
 class OpenIMU300 : public IMU
 {
   public:
@@ -143,35 +126,84 @@ class OpenIMU300 : public IMU
 
     virtual bool isValidMessage(uint32_t message_id) override;
 
-    virtual bool parseDataPacket(dwCANMessage packet, dwIMUFrame *IMUframe) override;
+    virtual bool parseDataPacket(const dwCANMessage &packet, dwIMUFrame *IMUframe) override;
 
     virtual void getSensorResetMessage(dwCANMessage *packet) override;
 
+    virtual uint8_t getMessageFilters(canMessageFilter *filters, uint8_t maxFilters) override;
+
+    virtual uint8_t getConfigSteps(configStep_t *steps, uint8_t maxSteps) override;
+
+    virtual const char* getConfigParamName(uint8_t param) override;
+
+    virtual bool getSaveConfigStep(configStep_t *step) override;
+
+    virtual bool getRuntimeConfigSteps(string paramsString, configStep_t *steps, uint8_t *count,
+                                       dwTime_t *newPeriod_us) override;
+
+    virtual void setDataPeriod(dwTime_t period_us) override;
+
+    virtual dwTime_t getDataPeriod() const override;
+
+    virtual void commitRuntimeConfig(uint32_t params) override;
+
+    // Decodes the payload of a data packet of the given type into frame, without
+    // timestamp compensation. Returns false if type is not a data packet.
+    static bool decodePayload(imuMessages type, const uint8_t *payload, dwIMUFrame *frame, uint8_t *sensorLatency);
+
   private:
     imuMessages findExtendedDataPacket(uint8_t pf, uint8_t ps);
 
+    imuMessages lookupPgn(uint8_t pf, uint8_t ps);
+
+    imuMessages findDataPacket(uint32_t message_id);
+
+    void buildPgnLookup();
+
 	imuMessages findStandardDataPacket(uint32_t message_id);
 
     void getBankOfPSPacket(uint8_t bank, uint8_t *reg, dwCANMessage *packet);
 
-    void getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessage *packet);
+    void getConfigPacket(IMUPARAM_t param, uint16_t paramVal, const imuParameters_t &values, dwCANMessage *packet);
+
+    void addConfigMessage(IMUPARAM_t param, uint16_t val, imuParameters_t *values, dwCANMessage *messages,
+                          uint32_t *params, uint8_t *count, int *filterMessage);
+
+    uint8_t buildConfigSteps(const dwCANMessage *messages, const uint32_t *params, uint8_t messageCount,
+                             configStep_t *steps, uint8_t maxSteps);
+
+    void getReadbackRequest(imuMessages setting, const dwCANMessage *message, configReadback_t *readback);
 
     void getPacketIdentifiers(uint32_t id, uint8_t *pf, uint8_t *ps);
 
-    bool getParameterVal(string searchString, string userString, uint16_t* value);
+    void compensateTimestamp(imuMessages type, const dwCANMessage &packet, uint8_t sensorLatency, dwIMUFrame *frame);
 
-    bool getParams(std::string userString, dwCANMessage **messages, uint8_t *count);
+    bool parseParamString(const string &userString, paramValues_t *params);
 
-    bool isValidBankOfPSPacket(uint16_t value);
+    bool getParams(const paramValues_t &params, dwCANMessage **messages, uint8_t *count);
 
-    template<typename T>
-    bool isValidConfigRequest(const T value, const T* validValues, const uint8_t len);
+    bool isValidBankOfPSPacket(uint32_t value);
+
+    bool isValidParam(IMUPARAM_t param, uint32_t value);
 
     void printPSList();
 
     uint8_t                       SRCAddress;
     uint8_t                       ECUAddress;
+    pgn                           pgnList[MAX_PGN];     // Copy of IMU300pgnList, remapped by Bank of PS parameters
     imuParameters_t               imuParameter;
+    imuParameters_t               startParameter;       // imuParameter after init(), before runtime changes
+    imuParameters_t               runtimeParameter;     // Values of the runtime change in progress, not confirmed
     dwCANMessage                  configMessages[PARAM_MAX_PARAMS];
     uint8_t                       configCount;
+    uint32_t                      configParams[PARAM_MAX_PARAMS];   // Bits of the IMUPARAM_t carried by configMessages[i]
+    bool                          latencyCompensation;  // Move frame timestamps to the sample time
+    uint32_t                      canBitrate;           // Used for the frame transmission time
+    std::atomic<dwTime_t>         dataPeriod_us;        // Period the IMU sends at now, set at runtime once observed
+    std::mutex                    runtimeLock;          // imuParameter and runtimeParameter during runtime changes
+    SampleClockEstimator          sampleClock[MAX_PGN]; // Receive jitter removal per data PGN
+    uint8_t                       pfRow[256];                           // PF -> row of pgnLookup
+    uint8_t                       pgnLookup[PGN_LOOKUP_MAX_PF][256];    // [row][PS] -> imuMessages
 };
+
+#endif // OPENIMU300_PLUGIN_H_
@@ -0,0 +1,174 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef PACKET_DECODER_H_
+#define PACKET_DECODER_H_
+
+#include <dw/sensors/imu/IMU.h>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Table driven decoder of fixed layout data packets.
+//
+// Each packet type is described by a constexpr packetLayout: the payload
+// fields, their little endian byte position and width, the linear conversion
+// to the frame unit and the dwIMUFrame member they are written to. The
+// decoder of a layout is a template instantiated from the table, so every
+// field offset, width and constant is known at compile time and the decode is
+// straight-line code without branches. Payload bytes are assembled with
+// shifts, the result does not depend on host byte order or alignment.
+//
+//   static constexpr packetLayout layouts[] = {...};
+//   typedef packetDecoderTable<MAX_TYPES, 4, layouts> decoders;
+//   decoders::decode[type](payload, &frame);
+
+#define PACKET_MAX_FIELDS     4       // Fields per layout
+#define PACKET_NO_LATENCY     0xFF    // latencyByte of layouts without a measurement latency
+
+typedef std::remove_extent<decltype(dwIMUFrame::turnrate)>::type frameValue_t;
+typedef decltype(dwIMUFrame::turnrate) dwIMUFrame::*frameVector_t;
+
+// value = raw * scale + offset, written to (frame.*vector)[axis].
+// A field of width 0 has no payload bytes and always writes offset.
+struct fieldDescriptor {
+  uint8_t       byteOffset;
+  uint8_t       width;          // Bytes, little endian, at most 4
+  frameValue_t  scale;
+  frameValue_t  offset;
+  frameVector_t vector;
+  uint8_t       axis;
+};
+
+struct packetLayout {
+  uint32_t        type;         // Packet type the layout decodes, index of the dispatch table
+  uint32_t        flags;        // dwIMUFrame flags set by the packet
+  uint8_t         latencyByte;  // Payload byte with the measurement latency, or PACKET_NO_LATENCY
+  uint8_t         fieldCount;
+  fieldDescriptor fields[PACKET_MAX_FIELDS];
+};
+
+// Decodes the payload into frame, sets the flags of the packet and returns
+// its measurement latency (0 when the packet has none)
+typedef uint8_t (*packetDecodeFn)(const uint8_t *payload, dwIMUFrame *frame);
+
+//----------------------------------------------------------------------------//
+
+template<uint8_t Width>
+inline uint32_t readLE(const uint8_t *data)
+{
+  static_assert(Width <= 4, "Fields are at most 32 bits");
+  return (static_cast<uint32_t>(data[Width - 1]) << (8 * (Width - 1))) | readLE<Width - 1>(data);
+}
+
+template<>
+inline uint32_t readLE<0>(const uint8_t *)
+{
+  return 0;
+}
+
+// Runtime width, for code that loops over the fields of a layout
+inline uint32_t readLE(const uint8_t *data, uint8_t width)
+{
+  uint32_t value = 0;
+  for(uint8_t i = 0; i < width; i++)
+  {
+    value |= static_cast<uint32_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+//----------------------------------------------------------------------------//
+
+template<size_t Count, const packetLayout (&Layouts)[Count], size_t Layout, uint8_t Field,
+         bool Done = (Field >= Layouts[Layout].fieldCount)>
+struct fieldDecoder
+{
+  static inline void decode(const uint8_t *payload, dwIMUFrame *frame)
+  {
+    constexpr fieldDescriptor field = Layouts[Layout].fields[Field];
+    (frame->*field.vector)[field.axis] =
+        static_cast<frameValue_t>(readLE<field.width>(payload + field.byteOffset)) * field.scale + field.offset;
+    fieldDecoder<Count, Layouts, Layout, Field + 1>::decode(payload, frame);
+  }
+};
+
+template<size_t Count, const packetLayout (&Layouts)[Count], size_t Layout, uint8_t Field>
+struct fieldDecoder<Count, Layouts, Layout, Field, true>
+{
+  static inline void decode(const uint8_t *, dwIMUFrame *)
+  {
+  }
+};
+
+template<size_t Count, const packetLayout (&Layouts)[Count], size_t Layout>
+uint8_t decodePacket(const uint8_t *payload, dwIMUFrame *frame)
+{
+  constexpr uint8_t latencyByte = Layouts[Layout].latencyByte;
+  static_assert(latencyByte == PACKET_NO_LATENCY || latencyByte < 8, "Latency byte outside of the payload");
+
+  fieldDecoder<Count, Layouts, Layout, 0>::decode(payload, frame);
+  frame->flags |= Layouts[Layout].flags;
+  return (latencyByte == PACKET_NO_LATENCY) ? 0 : payload[latencyByte % 8];
+}
+
+//----------------------------------------------------------------------------//
+
+// Position of the layout of a packet type in the table, Count if there is none
+template<size_t Count>
+constexpr size_t findLayout(const packetLayout (&layouts)[Count], uint32_t type, size_t index = 0)
+{
+  return (index == Count || layouts[index].type == type) ? index : findLayout(layouts, type, index + 1);
+}
+
+template<size_t Count, const packetLayout (&Layouts)[Count], size_t Layout>
+struct layoutDecodeFn
+{
+  static constexpr packetDecodeFn value = &decodePacket<Count, Layouts, Layout>;
+};
+
+template<size_t Count, const packetLayout (&Layouts)[Count]>
+struct layoutDecodeFn<Count, Layouts, Count>
+{
+  static constexpr packetDecodeFn value = nullptr;
+};
+
+template<size_t... I>
+struct indexSequence {};
+
+template<size_t N, size_t... I>
+struct makeIndexSequence : makeIndexSequence<N - 1, N - 1, I...> {};
+
+template<size_t... I>
+struct makeIndexSequence<0, I...>
+{
+  typedef indexSequence<I...> type;
+};
+
+template<size_t TypeCount, size_t Count, const packetLayout (&Layouts)[Count],
+         typename Sequence = typename makeIndexSequence<TypeCount>::type>
+struct packetDecoderTable;
+
+// Per packet type: the decoder, nullptr for types without a layout
+template<size_t TypeCount, size_t Count, const packetLayout (&Layouts)[Count], size_t... Type>
+struct packetDecoderTable<TypeCount, Count, Layouts, indexSequence<Type...>>
+{
+  static const packetDecodeFn decode[TypeCount];
+};
+
+template<size_t TypeCount, size_t Count, const packetLayout (&Layouts)[Count], size_t... Type>
+const packetDecodeFn packetDecoderTable<TypeCount, Count, Layouts, indexSequence<Type...>>::decode[TypeCount] = {
+  layoutDecodeFn<Count, Layouts, findLayout(Layouts, Type)>::value...
+};
+
+#endif // PACKET_DECODER_H_
@@ -0,0 +1,179 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef PARAM_TOKENIZER_H_
+#define PARAM_TOKENIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define VALUE_SET_WORDS       8       // ValueSet holds values [0, 512)
+
+// Characters of the parameter string, not owned and not null terminated
+struct paramView {
+  const char *data;
+  size_t      length;
+
+  bool equals(const char *text, size_t textLength) const
+  {
+    return length == textLength && memcmp(data, text, length) == 0;
+  }
+};
+
+struct paramToken {
+  paramView key;      // Without the '='
+  paramView value;
+};
+
+// Splits "key=value,key=value,..." into key/value views in one pass, without
+// copying or allocating. Entries without '=' are skipped.
+class ParamTokenizer
+{
+  public:
+    ParamTokenizer(const char *params, size_t length)
+    : cursor(params)
+    , end(params + length)
+    { }
+
+    bool next(paramToken *token)
+    {
+      while(cursor < end)
+      {
+        const char *entry = cursor;
+        const char *comma = static_cast<const char*>(memchr(entry, ',', end - entry));
+        const char *stop  = comma ? comma : end;
+        cursor            = comma ? comma + 1 : end;
+
+        const char *equals = static_cast<const char*>(memchr(entry, '=', stop - entry));
+        if(equals == nullptr)
+          continue;
+
+        token->key   = {entry, static_cast<size_t>(equals - entry)};
+        token->value = {equals + 1, static_cast<size_t>(stop - equals - 1)};
+        return true;
+      }
+      return false;
+    }
+
+  private:
+    const char *cursor;
+    const char *end;
+};
+
+//----------------------------------------------------------------------------//
+
+typedef enum{
+  PARAM_VALUE_OK,
+  PARAM_VALUE_EMPTY,
+  PARAM_VALUE_NOT_A_NUMBER,
+  PARAM_VALUE_OUT_OF_RANGE,
+}paramValueStatus_t;
+
+// Value of a digit in base 10 or 16, base if c is not a digit
+inline uint32_t paramDigit(char c, uint32_t base)
+{
+  uint32_t digit = base;
+  if(c >= '0' && c <= '9')
+    digit = c - '0';
+  else if(c >= 'a' && c <= 'f')
+    digit = c - 'a' + 10;
+  else if(c >= 'A' && c <= 'F')
+    digit = c - 'A' + 10;
+  return digit < base ? digit : base;
+}
+
+// Decimal, or hexadecimal with a 0x/0X prefix. Nothing else is accepted,
+// signs and spaces included.
+inline paramValueStatus_t parseParamValue(const paramView &text, uint32_t maxValue, uint32_t *value)
+{
+  size_t   pos  = 0;
+  uint32_t base = 10;
+  if(text.length > 2 && text.data[0] == '0' && (text.data[1] == 'x' || text.data[1] == 'X'))
+  {
+    pos  = 2;
+    base = 16;
+  }
+  if(pos == text.length)
+    return PARAM_VALUE_EMPTY;
+
+  uint64_t result   = 0;
+  bool     overflow = false;
+  for(; pos < text.length; pos++)
+  {
+    uint32_t digit = paramDigit(text.data[pos], base);
+    if(digit == base)
+      return PARAM_VALUE_NOT_A_NUMBER;
+
+    // Checked per digit, so result cannot wrap on long inputs
+    result   = result * base + digit;
+    overflow = overflow || result > maxValue;
+    if(overflow)
+      result = 0;
+  }
+  if(overflow)
+    return PARAM_VALUE_OUT_OF_RANGE;
+
+  *value = static_cast<uint32_t>(result);
+  return PARAM_VALUE_OK;
+}
+
+inline const char* paramValueError(paramValueStatus_t status)
+{
+  switch(status)
+  {
+    case PARAM_VALUE_OK:            return "ok";
+    case PARAM_VALUE_EMPTY:         return "empty";
+    case PARAM_VALUE_NOT_A_NUMBER:  return "not a decimal or 0x hexadecimal number";
+    case PARAM_VALUE_OUT_OF_RANGE:  return "out of range";
+  }
+  return "invalid";
+}
+
+//----------------------------------------------------------------------------//
+
+// Set of small unsigned values built at compile time, membership is one
+// shift and mask:
+//   static constexpr ValueSet rates(0, 1, 2, 4);
+//   rates.contains(x);
+class ValueSet
+{
+  public:
+    template<typename... Values>
+    constexpr ValueSet(Values... values)
+    : bits{word(0, values...), word(1, values...), word(2, values...), word(3, values...),
+           word(4, values...), word(5, values...), word(6, values...), word(7, values...)}
+    { }
+
+    bool contains(uint32_t value) const
+    {
+      return value < 64 * VALUE_SET_WORDS && ((bits[value / 64] >> (value % 64)) & 1) != 0;
+    }
+
+  private:
+    static constexpr uint64_t word(size_t)
+    {
+      return 0;
+    }
+
+    template<typename... Values>
+    static constexpr uint64_t word(size_t index, unsigned value, Values... values)
+    {
+      return value >= 64 * VALUE_SET_WORDS ? throw "ValueSet: value too large"
+           : (value / 64 == index ? uint64_t(1) << (value % 64) : 0) | word(index, values...);
+    }
+
+    uint64_t bits[VALUE_SET_WORDS];
+};
+
+#endif // PARAM_TOKENIZER_H_
@@ -0,0 +1,118 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef PLUGIN_STATS_H_
+#define PLUGIN_STATS_H_
+
+#include <imu_plugin_stats.h>
+#include <latency_histogram.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define PLUGIN_STATS_DEFAULT_PERIOD_MS  1000    // statsPeriod=
+
+// Inlined even without optimization, so disabled instrumentation leaves no calls
+#define PLUGIN_STATS_STUB               inline __attribute__((always_inline))
+
+// Hot path instrumentation of one sensor, compiled in with ENABLE_PLUGIN_STATS
+// (IMU_PLUGIN_STATS). Otherwise every member is an empty inline function and
+// timestamps are empty structs, so the calls in the plugin compile to nothing.
+//
+// Stages and PGN counters are recorded by the threads calling into the
+// plugin and read with snapshot() from any thread. With dump(), a background
+// thread appends a snapshot to a file every period as one JSON object per line.
+class PluginStats
+{
+  public:
+#ifdef IMU_PLUGIN_STATS
+    typedef std::chrono::steady_clock::time_point timestamp_t;
+
+    static constexpr bool enabled = true;
+
+    PluginStats();
+
+    ~PluginStats();
+
+    static timestamp_t now()
+    {
+      return std::chrono::steady_clock::now();
+    }
+
+    void record(pluginStage_t stage, timestamp_t start)
+    {
+      stages[stage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(now() - start).count());
+    }
+
+    // Called by the parsing thread for every message given to the decoder
+    void countMessage(uint32_t id, bool decoded);
+
+    void snapshot(pluginStats_t *stats) const;
+
+    // Starts appending snapshots to path every period_ms
+    dwStatus dump(const std::string &path, uint32_t period_ms);
+
+    void stopDump();
+
+  private:
+    void dumpLoop();
+
+    void write(const pluginStats_t &stats);
+
+    LatencyHistogram              stages[PLUGIN_STAGE_COUNT];
+    std::atomic<uint32_t>         pgns[PLUGIN_STATS_MAX_PGNS];
+    std::atomic<uint64_t>         messages[PLUGIN_STATS_MAX_PGNS];
+    std::atomic<uint64_t>         failures[PLUGIN_STATS_MAX_PGNS];
+    std::atomic<uint32_t>         pgnCount;
+    std::atomic<uint64_t>         otherMessages;
+
+    FILE                          *file;
+    uint32_t                      period_ms;
+    bool                          running;
+    std::thread                   dumper;
+    std::mutex                    lock;
+    std::condition_variable       signal;
+#else
+    struct timestamp_t {};
+
+    static constexpr bool enabled = false;
+
+    PLUGIN_STATS_STUB static timestamp_t now()
+    {
+      return timestamp_t();
+    }
+
+    PLUGIN_STATS_STUB void record(pluginStage_t, timestamp_t)
+    { }
+
+    PLUGIN_STATS_STUB void countMessage(uint32_t, bool)
+    { }
+
+    PLUGIN_STATS_STUB void snapshot(pluginStats_t *) const
+    { }
+
+    PLUGIN_STATS_STUB dwStatus dump(const std::string &, uint32_t)
+    {
+      return DW_NOT_SUPPORTED;
+    }
+
+    PLUGIN_STATS_STUB void stopDump()
+    { }
+#endif // IMU_PLUGIN_STATS
+};
+
+#endif // PLUGIN_STATS_H_
@@ -0,0 +1,72 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef REPLAY_TRANSPORT_H_
+#define REPLAY_TRANSPORT_H_
+
+#include <can_transport.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Offline transport, selected with can-proto=can.replay,file=<path>.
+//
+// The capture file is a plain array of dwCANMessage records (see
+// tools/candump2dwcan.cpp to convert a candump log). It is memory mapped and
+// served through readMessageRef() without copying. Compact recordings made
+// with record= are recognized by their header and expanded into memory once. Messages are replayed
+// either at their original timing or as fast as they are read.
+class ReplayCANTransport : public CANTransport
+{
+  public:
+    ReplayCANTransport(bool realtime);
+
+    virtual ~ReplayCANTransport() override;
+
+    dwStatus open(const std::string &path);
+
+    virtual dwStatus start() override;
+
+    virtual dwStatus stop() override;
+
+    virtual dwStatus reset() override;
+
+    virtual dwStatus release() override;
+
+    virtual dwStatus readMessage(dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus readMessageRef(const dwCANMessage **message, dwTime_t timeout_us) override;
+
+    virtual dwStatus sendMessage(const dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus setFilters(const canMessageFilter *filters, uint8_t count) override;
+
+    virtual bool ownsMessage(const dwCANMessage *message) const override;
+
+  private:
+    dwStatus waitUntilDue(const dwCANMessage *message, dwTime_t timeout_us);
+
+    void unmap();
+
+    bool                          realtime;         // Keep the recorded message spacing
+    void                          *mapping;
+    size_t                        mappingSize;
+    std::vector<dwCANMessage>     decoded;          // Expanded compact recording
+    const dwCANMessage            *records;
+    size_t                        recordCount;
+    size_t                        nextRecord;
+    dwTime_t                      firstTimestamp;   // Timestamp of the record replayed at startTime
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif // REPLAY_TRANSPORT_H_
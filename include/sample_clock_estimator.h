@@ -0,0 +1,91 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef SAMPLE_CLOCK_ESTIMATOR_H_
+#define SAMPLE_CLOCK_ESTIMATOR_H_
+
+#include <dw/sensors/imu/IMU.h>
+#include <algorithm>
+
+#define SAMPLE_CLOCK_MAX_DRIFT_PPM    500     // Sensor vs host clock drift the estimator follows
+
+// Removes receive jitter from the timestamps of a periodic message.
+//
+// The IMU sends each data PGN once per period, so receive time is
+//   t_k = t_0 + k * period + transport delay + jitter_k,  jitter_k >= 0.
+// The estimator tracks the lower envelope of the receive times on that grid:
+// a message arriving later than predicted is stamped with the prediction, one
+// arriving earlier moves the grid back. The prediction is allowed to creep
+// forward by SAMPLE_CLOCK_MAX_DRIFT_PPM so a slower sensor clock does not
+// accumulate error.
+class SampleClockEstimator
+{
+  public:
+    SampleClockEstimator()
+    : m_period_us(0)
+    {
+      reset();
+    }
+
+    void setPeriod(dwTime_t period_us)
+    {
+      if(period_us != m_period_us)
+      {
+        m_period_us = period_us;
+        reset();
+      }
+    }
+
+    void reset()
+    {
+      m_estimate_us = 0;
+      m_valid       = false;
+    }
+
+    // Returns the de-jittered timestamp for a message received at rxTime_us
+    dwTime_t update(dwTime_t rxTime_us)
+    {
+      if(m_period_us <= 0)
+        return rxTime_us;
+
+      dwTime_t elapsed = rxTime_us - m_estimate_us;
+      if(!m_valid || elapsed < -m_period_us || elapsed > 100 * m_period_us)
+      {
+        // First message, clock jump or long gap: restart from this message
+        m_estimate_us = rxTime_us;
+        m_valid       = true;
+        return rxTime_us;
+      }
+
+      // Number of periods since the last message, covers dropped messages
+      dwTime_t periods   = (elapsed + m_period_us / 2) / m_period_us;
+      if(periods < 1)
+        periods = 1;
+      dwTime_t predicted = m_estimate_us + periods * m_period_us;
+      dwTime_t slack     = periods * m_period_us * SAMPLE_CLOCK_MAX_DRIFT_PPM / 1000000;
+
+      if(rxTime_us <= predicted)
+        m_estimate_us = rxTime_us;
+      else
+        m_estimate_us = predicted + std::min(rxTime_us - predicted, slack);
+
+      return m_estimate_us;
+    }
+
+  private:
+    dwTime_t      m_period_us;
+    dwTime_t      m_estimate_us;    // Lower envelope at the last message
+    bool          m_valid;
+};
+
+#endif // SAMPLE_CLOCK_ESTIMATOR_H_
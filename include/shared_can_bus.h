@@ -0,0 +1,145 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef SHARED_CAN_BUS_H_
+#define SHARED_CAN_BUS_H_
+
+#include <can_transport.h>
+#include <spsc_ring.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SHARED_BUS_QUEUE_SIZE       1024      // Messages buffered per IMU, power of two
+#define SHARED_BUS_POLL_TIMEOUT_US  10000     // Bounds how long stop() waits for the reader thread
+
+class SharedBusTransport;
+
+// One CAN transport read by a single thread on behalf of several IMUs.
+//
+// Messages are routed by their J1939 source address (low byte of the id) to
+// the SharedBusTransport attached for that address. Messages from addresses
+// nobody attached are dropped by the reader, so each message is read from
+// the bus once regardless of the number of IMUs. Buses are shared by key,
+// typically protocol and device, within the process.
+//
+// The reader looks up routes without a lock. detach() clears the route and
+// waits until the reader is not delivering, so a detached client is never
+// called again.
+class SharedCANBus
+{
+  public:
+    typedef std::function<dwStatus(std::unique_ptr<CANTransport>*)> transportFactory_t;
+
+    // Returns the bus registered under key, opening its transport with
+    // create() if there is none yet
+    static std::shared_ptr<SharedCANBus> get(const std::string &key, const transportFactory_t &create, dwStatus *status);
+
+    ~SharedCANBus();
+
+    dwStatus attach(SharedBusTransport *client, uint8_t address);
+
+    void detach(SharedBusTransport *client);
+
+    // The transport and the reader run while at least one client is started
+    dwStatus start(SharedBusTransport *client);
+
+    dwStatus stop(SharedBusTransport *client);
+
+    dwStatus reset();
+
+    dwStatus send(const dwCANMessage *message, dwTime_t timeout_us);
+
+    // Installs the union of the filters of all clients on the transport
+    dwStatus updateFilters();
+
+    // Messages read from the transport, independent of the number of clients
+    uint64_t getReadCount() const
+    {
+      return readCount.load(std::memory_order_relaxed);
+    }
+
+    SharedCANBus(std::unique_ptr<CANTransport> transport);
+
+  private:
+    void readerLoop();
+
+    std::unique_ptr<CANTransport> transport;
+    std::mutex                    runLock;          // Serializes start() and stop() including the reader join, never taken by the reader
+    std::mutex                    lock;             // Clients, changes of routes and transport control
+    std::mutex                    sendLock;
+    std::atomic<SharedBusTransport*> routes[256];   // Source address -> client, read by the reader without lock
+    std::atomic<bool>             routing;          // Reader is between the route lookup and the delivery
+    std::vector<SharedBusTransport*> clients;
+    size_t                        startedClients;
+    std::thread                   reader;
+    std::atomic<bool>             readerRunning;
+    std::atomic<uint64_t>         readCount;
+};
+
+// Per IMU view of a SharedCANBus, used as the plugin transport with sharedBus=1
+class SharedBusTransport : public CANTransport
+{
+  public:
+    SharedBusTransport(std::shared_ptr<SharedCANBus> bus, uint8_t address);
+
+    virtual ~SharedBusTransport() override;
+
+    dwStatus attach();
+
+    virtual dwStatus start() override;
+
+    virtual dwStatus stop() override;
+
+    virtual dwStatus reset() override;
+
+    virtual dwStatus release() override;
+
+    virtual dwStatus readMessage(dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus sendMessage(const dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus setFilters(const canMessageFilter *filters, uint8_t count) override;
+
+    const std::vector<canMessageFilter>& getFilters() const
+    {
+      return filters;
+    }
+
+  private:
+    friend class SharedCANBus;
+
+    // Called by the bus reader thread
+    void deliver(const dwCANMessage &message);
+
+    void endOfStream();
+
+    std::shared_ptr<SharedCANBus> bus;
+    uint8_t                       address;
+    bool                          attached;
+    bool                          started;
+    std::vector<canMessageFilter> filters;
+    SPSCRing<dwCANMessage, SHARED_BUS_QUEUE_SIZE> queue;
+    std::atomic<bool>             waiting;          // readMessage() is blocked on signal
+    std::atomic<bool>             ended;
+    std::mutex                    waitLock;
+    std::condition_variable       signal;
+};
+
+#endif // SHARED_CAN_BUS_H_
@@ -0,0 +1,95 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef SOCKETCAN_TRANSPORT_H_
+#define SOCKETCAN_TRANSPORT_H_
+
+#include <can_transport.h>
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+
+#define SOCKETCAN_DEFAULT_BATCH         16      // Frames fetched per recvmmsg() call
+#define SOCKETCAN_MAX_BATCH             256
+#define SOCKETCAN_CONTROL_SIZE          128     // Ancillary data buffer per frame, holds SCM_TIMESTAMPING
+#define SOCKETCAN_SEND_BACKOFF_MIN_US   100     // First wait when the transmit queue is full (ENOBUFS)
+#define SOCKETCAN_SEND_BACKOFF_MAX_US   5000    // Longest wait between retries on a full transmit queue
+
+// Where the dwCANMessage timestamp of a received frame comes from
+typedef enum{
+  TIMESTAMP_HOST      = 0,    // Userspace clock when the batch was received
+  TIMESTAMP_KERNEL    = 1,    // Kernel software receive timestamp, CLOCK_REALTIME
+  TIMESTAMP_HARDWARE  = 2,    // Adapter raw hardware timestamp, enabled with SIOCSHWTSTAMP
+}canTimestampSource_t;
+
+// Raw SocketCAN transport, selected with can-proto=can.native,device=<if>.
+//
+// Bypasses the DriveWorks SAL CAN sensor: the IMU message filters are
+// installed in the kernel with CAN_RAW_FILTER so foreign bus traffic never
+// reaches userspace, and frames are fetched in batches with recvmmsg().
+// Works on any SocketCAN interface including vcan.
+//
+// Receive timestamps can be taken from the kernel (SO_TIMESTAMPING) so they do
+// not include the scheduling delay of the reading thread. Hardware timestamps
+// are in the adapter clock domain, which is only the system clock if the
+// adapter clock is synchronized to it. A stream never mixes the two clocks:
+// if hardware timestamps stop arriving, it stays on kernel timestamps.
+class SocketCANTransport : public CANTransport
+{
+  public:
+    SocketCANTransport(size_t batchSize = SOCKETCAN_DEFAULT_BATCH);
+
+    virtual ~SocketCANTransport() override;
+
+    dwStatus open(const std::string &device);
+
+    dwStatus setTimestampSource(canTimestampSource_t source);
+
+    virtual dwStatus start() override;
+
+    virtual dwStatus stop() override;
+
+    virtual dwStatus reset() override;
+
+    virtual dwStatus release() override;
+
+    virtual dwStatus readMessage(dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus sendMessage(const dwCANMessage *message, dwTime_t timeout_us) override;
+
+    virtual dwStatus setFilters(const canMessageFilter *filters, uint8_t count) override;
+
+  private:
+    dwStatus receiveBatch(dwTime_t timeout_us);
+
+    dwStatus waitSocket(short events, dwTime_t timeout_us);
+
+    static dwTime_t getTimeUs();
+
+    dwTime_t getFrameTimestamp(struct msghdr *header, dwTime_t hostTime);
+
+    int                           socketFd;
+    std::string                   deviceName;
+    size_t                        batchSize;
+    size_t                        batchCount;       // Frames received by the last recvmmsg()
+    size_t                        batchIndex;       // Next frame to hand out
+    canTimestampSource_t          timestampSource;
+    std::vector<struct can_frame> frames;
+    std::vector<struct iovec>     iovecs;
+    std::vector<struct mmsghdr>   headers;
+    std::vector<char>             control;          // SOCKETCAN_CONTROL_SIZE bytes per frame
+    std::vector<dwTime_t>         timestamps;       // Receive time of each frame in the batch
+};
+
+#endif // SOCKETCAN_TRANSPORT_H_
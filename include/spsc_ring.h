@@ -0,0 +1,154 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define CACHE_LINE_SIZE     64
+
+// Fixed capacity, lock-free single producer / single consumer ring.
+//
+// Elements are stored inline, nothing is allocated after construction.
+// Producer and consumer indices live on separate cache lines so push() and
+// front()/pop() can run on different threads without false sharing. Explicit
+// padding is used instead of alignas because the owning objects are created
+// with plain new, which does not honour over-aligned types in C++11.
+//
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SPSCRing
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "SPSCRing capacity must be a power of two");
+
+  public:
+    SPSCRing()
+    : m_head(0)
+    , m_cachedTail(0)
+    , m_tail(0)
+    , m_cachedHead(0)
+    , m_overflow(0)
+    , m_highWatermark(0)
+    { }
+
+    // Producer: copies item into the ring, returns false and counts an
+    // overflow if the ring is full.
+    bool push(const T &item)
+    {
+      const size_t tail = m_tail.load(std::memory_order_relaxed);
+      if(tail - m_cachedHead == Capacity)
+      {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        if(tail - m_cachedHead == Capacity)
+        {
+          m_overflow.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+      }
+
+      m_items[tail & (Capacity - 1)] = item;
+      m_tail.store(tail + 1, std::memory_order_release);
+
+      const size_t used = tail + 1 - m_cachedHead;
+      if(used > m_highWatermark.load(std::memory_order_relaxed))
+        m_highWatermark.store(used, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Consumer: returns the oldest element without removing it, nullptr if
+    // the ring is empty. The element stays valid until pop().
+    const T* front()
+    {
+      const size_t head = m_head.load(std::memory_order_relaxed);
+      if(head == m_cachedTail)
+      {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        if(head == m_cachedTail)
+          return nullptr;
+      }
+      return &m_items[head & (Capacity - 1)];
+    }
+
+    // Consumer: returns up to maxCount of the oldest elements that are
+    // contiguous in memory, i.e. up to the end of the storage. The elements
+    // stay valid until they are popped.
+    size_t frontBatch(const T **first, size_t maxCount)
+    {
+      const size_t head = m_head.load(std::memory_order_relaxed);
+      m_cachedTail      = m_tail.load(std::memory_order_acquire);
+
+      size_t available  = m_cachedTail - head;
+      size_t contiguous = Capacity - (head & (Capacity - 1));
+      *first = &m_items[head & (Capacity - 1)];
+      return std::min(std::min(available, contiguous), maxCount);
+    }
+
+    // Consumer: removes the count oldest elements.
+    void pop(size_t count = 1)
+    {
+      const size_t head = m_head.load(std::memory_order_relaxed);
+      m_head.store(head + count, std::memory_order_release);
+    }
+
+    // Consumer: drops everything currently in the ring.
+    void clear()
+    {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      m_head.store(m_cachedTail, std::memory_order_release);
+    }
+
+    // Number of elements in the ring, exact only when called from the
+    // producer or consumer thread while the other side is idle.
+    size_t size() const
+    {
+      return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity()
+    {
+      return Capacity;
+    }
+
+    // Number of push() calls rejected because the ring was full
+    uint64_t overflowCount() const
+    {
+      return m_overflow.load(std::memory_order_relaxed);
+    }
+
+    // Highest occupancy seen by the producer
+    size_t highWatermark() const
+    {
+      return m_highWatermark.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Consumer cache line
+    std::atomic<size_t>   m_head;
+    size_t                m_cachedTail;
+    char                  m_padConsumer[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    // Producer cache line
+    std::atomic<size_t>   m_tail;
+    size_t                m_cachedHead;
+    std::atomic<uint64_t> m_overflow;
+    std::atomic<size_t>   m_highWatermark;
+    char                  m_padProducer[CACHE_LINE_SIZE - 2 * sizeof(std::atomic<size_t>) - sizeof(size_t) - sizeof(std::atomic<uint64_t>)];
+
+    T                     m_items[Capacity];
+};
+
+#endif // SPSC_RING_H_
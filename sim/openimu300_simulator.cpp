@@ -0,0 +1,426 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include "openimu300_simulator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// Default PGNs of the sensor, same as IMU300pgnList in the plugin
+#define SIM_PRIORITY            0x18000000
+#define SIM_PF_CONFIG           255
+#define SIM_PF_REQUEST          234     // Request PGN, PS is the destination address
+#define SIM_PF_DATA             240
+#define SIM_PS_SSI1             41
+#define SIM_PS_ANGULAR_RATE     42
+#define SIM_PS_ACCEL            45
+#define SIM_PS_MAGNETOMETER     106     // PF 255
+#define SIM_PS_BOPS_BANK0       240
+#define SIM_PS_BOPS_BANK1       241
+#define SIM_PS_SAVE_CONFIG      81
+
+#define SIM_SEND_TIMEOUT_US     1000
+#define SIM_CONFIG_POLL_US      1000    // Max sleep between checks for configuration messages
+#define SIM_MAX_FLOOD_BURST     1024    // Foreign messages sent per loop when behind
+
+static const uint8_t simValidPacketRates[] = {0,1,2,4,5,10,20,25,50};
+
+//----------------------------------------------------------------------------//
+
+static uint16_t encodeWord(double value, double offset, double scale)
+{
+  double raw = (value + offset) * scale;
+  if(raw < 0)
+    raw = 0;
+  if(raw > 65535)
+    raw = 65535;
+  return static_cast<uint16_t>(raw + 0.5);
+}
+
+//----------------------------------------------------------------------------//
+
+static void putWord(uint8_t *data, uint16_t value)
+{
+  data[0] = static_cast<uint8_t>(value & 0xFF);
+  data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+//----------------------------------------------------------------------------//
+
+OpenIMU300Simulator::OpenIMU300Simulator(CANTransport *bus, const simulatorOptions_t &options)
+: bus(bus)
+, options(options)
+, stopRequested(false)
+, rateLPF(0)
+, accelLPF(0)
+, orientation(0)
+, rng(options.seed)
+, samples(0)
+, sent(0)
+, dropped(0)
+, flooded(0)
+, configApplied(0)
+, readbacks(0)
+, saves(0)
+{
+  configPS[SIM_PS_RESET_ALGORITHM] = 80;
+  configPS[SIM_PS_PACKET_RATE]     = 85;
+  configPS[SIM_PS_PACKET_TYPE]     = 86;
+  configPS[SIM_PS_FILTER_FREQ]     = 87;
+  configPS[SIM_PS_ORIENTATION]     = 88;
+}
+
+//----------------------------------------------------------------------------//
+
+simulatorOptions_t OpenIMU300Simulator::defaultOptions()
+{
+  simulatorOptions_t options;
+  options.address       = 0x80;
+  options.packetRate    = 1;
+  options.packetType    = SIM_PACKET_SSI1 | SIM_PACKET_RATE | SIM_PACKET_ACCEL | SIM_PACKET_MAG;
+  options.basePeriod_us = SIM_BASE_PERIOD_US;
+  options.jitter_us     = 0;
+  options.dropRate      = 0;
+  options.floodRate     = 0;
+  options.seed          = 1;
+  return options;
+}
+
+//----------------------------------------------------------------------------//
+
+simulatorStats_t OpenIMU300Simulator::getStats() const
+{
+  simulatorStats_t stats;
+  stats.samples       = samples;
+  stats.sent          = sent;
+  stats.dropped       = dropped;
+  stats.flooded       = flooded;
+  stats.configApplied = configApplied;
+  stats.readbacks     = readbacks;
+  stats.saves         = saves;
+  return stats;
+}
+
+//----------------------------------------------------------------------------//
+
+void OpenIMU300Simulator::stop()
+{
+  stopRequested = true;
+}
+
+//----------------------------------------------------------------------------//
+
+void OpenIMU300Simulator::buildMessage(uint8_t pf, uint8_t ps, dwCANMessage *message)
+{
+  memset(message, 0, sizeof(*message));
+  message->id   = SIM_PRIORITY | (pf << 16) | (ps << 8) | options.address;
+  message->size = 8;
+}
+
+//----------------------------------------------------------------------------//
+
+// Answers a request for a configuration PGN with the current setting, in the
+// format of the configuration message
+bool OpenIMU300Simulator::answerRequest(uint8_t pf, uint8_t ps)
+{
+  dwCANMessage message;
+  if(pf != SIM_PF_CONFIG)
+    return false;
+
+  buildMessage(pf, ps, &message);
+  message.data[0] = options.address;
+  if(ps == configPS[SIM_PS_PACKET_RATE])
+  {
+    message.size    = 2;
+    message.data[1] = static_cast<uint8_t>(options.packetRate);
+  }
+  else if(ps == configPS[SIM_PS_PACKET_TYPE])
+  {
+    message.size    = 3;
+    message.data[1] = static_cast<uint8_t>(options.packetType);
+  }
+  else if(ps == configPS[SIM_PS_FILTER_FREQ])
+  {
+    message.size    = 3;
+    message.data[1] = rateLPF;
+    message.data[2] = accelLPF;
+  }
+  else if(ps == configPS[SIM_PS_ORIENTATION])
+  {
+    message.size    = 3;
+    message.data[1] = static_cast<uint8_t>(orientation >> 8);
+    message.data[2] = static_cast<uint8_t>(orientation & 0xFF);
+  }
+  else
+  {
+    return false;
+  }
+
+  if(bus->sendMessage(&message, SIM_SEND_TIMEOUT_US) != DW_SUCCESS)
+    return false;
+  readbacks++;
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+bool OpenIMU300Simulator::handleMessage(const dwCANMessage &message)
+{
+  uint8_t pf = (message.id >> 16) & 0xFF;
+  uint8_t ps = (message.id >> 8) & 0xFF;
+
+  // Request PGN, payload is the requested PGN as PS, PF, data page
+  if(pf == SIM_PF_REQUEST && message.size >= 3 && (ps == options.address || ps == 0xFF))
+    return answerRequest(message.data[1], message.data[0]);
+
+  if(pf != SIM_PF_CONFIG || message.size < 2)
+    return false;
+
+  // Algorithm reset carries the ECU address in the second byte
+  if(ps == configPS[SIM_PS_RESET_ALGORITHM])
+  {
+    if(message.data[1] != options.address)
+      return false;
+    configApplied++;
+    return true;
+  }
+
+  // Save configuration, same layout, answered with response 1 and success 1
+  if(ps == SIM_PS_SAVE_CONFIG)
+  {
+    if(message.size < 3 || message.data[0] != 0 || message.data[1] != options.address)
+      return false;
+
+    dwCANMessage answer;
+    buildMessage(SIM_PF_CONFIG, SIM_PS_SAVE_CONFIG, &answer);
+    answer.size    = 3;
+    answer.data[0] = 1;
+    answer.data[1] = options.address;
+    answer.data[2] = 1;
+    if(bus->sendMessage(&answer, SIM_SEND_TIMEOUT_US) != DW_SUCCESS)
+      return false;
+    saves++;
+    return true;
+  }
+
+  if(message.data[0] != options.address)
+    return false;
+
+  if(ps == SIM_PS_BOPS_BANK0 || ps == SIM_PS_BOPS_BANK1)
+  {
+    // Zero keeps the current PS of an entry
+    if(ps == SIM_PS_BOPS_BANK0)
+    {
+      if(message.data[1] != 0)
+        configPS[SIM_PS_RESET_ALGORITHM] = message.data[1];
+    }
+    else
+    {
+      for(int i = SIM_PS_PACKET_RATE; i < SIM_PS_MAX && i < message.size; i++)
+      {
+        if(message.data[i] != 0)
+          configPS[i] = message.data[i];
+      }
+    }
+  }
+  else if(ps == configPS[SIM_PS_PACKET_RATE])
+  {
+    const uint8_t *end = simValidPacketRates + sizeof(simValidPacketRates);
+    if(std::find(simValidPacketRates, end, message.data[1]) == end)
+      return false;
+    options.packetRate = message.data[1];
+  }
+  else if(ps == configPS[SIM_PS_PACKET_TYPE])
+  {
+    options.packetType = message.data[1];
+  }
+  else if(ps == configPS[SIM_PS_FILTER_FREQ] && message.size >= 3)
+  {
+    rateLPF  = message.data[1];
+    accelLPF = message.data[2];
+  }
+  else if(ps == configPS[SIM_PS_ORIENTATION] && message.size >= 3)
+  {
+    orientation = static_cast<uint16_t>((message.data[1] << 8) | message.data[2]);
+  }
+  else
+  {
+    return false;
+  }
+
+  configApplied++;
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+void OpenIMU300Simulator::sendSample(dwTime_t sampleTime_us)
+{
+  const double pi = 3.14159265358979;
+  double t        = sampleTime_us * 1e-6;
+  double wobble   = std::sin(2 * pi * 0.5 * t);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  dwCANMessage message;
+
+  struct{
+    uint16_t bit;
+    uint8_t  pf;
+    uint8_t  ps;
+  } packets[] = {
+    {SIM_PACKET_SSI1,  SIM_PF_DATA,   SIM_PS_SSI1},
+    {SIM_PACKET_RATE,  SIM_PF_DATA,   SIM_PS_ANGULAR_RATE},
+    {SIM_PACKET_ACCEL, SIM_PF_DATA,   SIM_PS_ACCEL},
+    {SIM_PACKET_MAG,   SIM_PF_CONFIG, SIM_PS_MAGNETOMETER},
+  };
+
+  for(const auto &packet : packets)
+  {
+    if((options.packetType & packet.bit) == 0)
+      continue;
+
+    if(options.dropRate > 0 && chance(rng) < options.dropRate)
+    {
+      dropped++;
+      continue;
+    }
+
+    buildMessage(packet.pf, packet.ps, &message);
+    switch(packet.bit)
+    {
+      case SIM_PACKET_SSI1:     // 24 bit pitch and roll, 1/32768 deg with -250 deg offset
+      {
+        uint32_t pitch = static_cast<uint32_t>((2.0 * wobble + 250.0) * 32768.0);
+        uint32_t roll  = static_cast<uint32_t>((1.0 * wobble + 250.0) * 32768.0);
+        message.data[0] = pitch & 0xFF;
+        message.data[1] = (pitch >> 8) & 0xFF;
+        message.data[2] = (pitch >> 16) & 0xFF;
+        message.data[3] = roll & 0xFF;
+        message.data[4] = (roll >> 8) & 0xFF;
+        message.data[5] = (roll >> 16) & 0xFF;
+        message.data[6] = 0;
+        message.data[7] = SIM_MEASUREMENT_LATENCY;
+        break;
+      }
+      case SIM_PACKET_RATE:     // 1/128 deg/s with -250 deg/s offset
+        putWord(&message.data[0], encodeWord(5.0 * wobble, 250.0, 128.0));
+        putWord(&message.data[2], encodeWord(-5.0 * wobble, 250.0, 128.0));
+        putWord(&message.data[4], encodeWord(10.0, 250.0, 128.0));
+        message.data[6] = 0;
+        message.data[7] = SIM_MEASUREMENT_LATENCY;
+        break;
+      case SIM_PACKET_ACCEL:    // 0.01 m/s^2 with -320 m/s^2 offset
+        putWord(&message.data[0], encodeWord(0.1 * wobble, 320.0, 100.0));
+        putWord(&message.data[2], encodeWord(0.0, 320.0, 100.0));
+        putWord(&message.data[4], encodeWord(9.81, 320.0, 100.0));
+        break;
+      default:                  // 0.025 uT with -800 uT offset
+        putWord(&message.data[0], encodeWord(20.0, 800.0, 40.0));
+        putWord(&message.data[2], encodeWord(0.0, 800.0, 40.0));
+        putWord(&message.data[4], encodeWord(-40.0, 800.0, 40.0));
+        break;
+    }
+
+    if(bus->sendMessage(&message, SIM_SEND_TIMEOUT_US) == DW_SUCCESS)
+      sent++;
+    else
+      dropped++;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+// Traffic from other nodes, some of it on the IMU PGNs
+void OpenIMU300Simulator::sendFlood()
+{
+  std::uniform_int_distribution<int> byte(0, 255);
+  dwCANMessage message;
+
+  uint8_t source = static_cast<uint8_t>(byte(rng));
+  if(source == options.address)
+    source++;
+
+  memset(&message, 0, sizeof(message));
+  if(byte(rng) < 64)
+    message.id = SIM_PRIORITY | (SIM_PF_DATA << 16) | (SIM_PS_ANGULAR_RATE << 8) | source;
+  else
+    message.id = (static_cast<uint32_t>(byte(rng) & 0x1C) << 24) | (byte(rng) << 16) | (byte(rng) << 8) | source;
+  message.size = 8;
+  for(int i = 0; i < 8; i++)
+    message.data[i] = static_cast<uint8_t>(byte(rng));
+
+  if(bus->sendMessage(&message, SIM_SEND_TIMEOUT_US) == DW_SUCCESS)
+    flooded++;
+}
+
+//----------------------------------------------------------------------------//
+
+void OpenIMU300Simulator::run(dwTime_t duration_us)
+{
+  typedef std::chrono::steady_clock clock;
+  std::uniform_int_distribution<dwTime_t> jitter(0, options.jitter_us > 0 ? options.jitter_us : 0);
+
+  auto start = clock::now();
+  auto elapsed = [&start]() {
+    return static_cast<dwTime_t>(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count());
+  };
+
+  dwTime_t nextSample = 0;
+  dwTime_t sendAt     = jitter(rng);
+  double   nextFlood  = 0;
+
+  while(!stopRequested)
+  {
+    dwCANMessage message;
+    while(bus->readMessage(&message, 0) == DW_SUCCESS)
+      handleMessage(message);
+
+    dwTime_t now = elapsed();
+    if(duration_us > 0 && now >= duration_us)
+      break;
+
+    dwTime_t period = options.basePeriod_us * options.packetRate;
+    if(period > 0 && now >= sendAt)
+    {
+      sendSample(nextSample);
+      samples++;
+
+      nextSample += period;
+      if(now - nextSample > 100 * period)
+        nextSample = now;     // Too far behind, skip ahead instead of bursting
+      sendAt = nextSample + jitter(rng);
+    }
+
+    if(options.floodRate > 0)
+    {
+      for(int burst = 0; now >= nextFlood && burst < SIM_MAX_FLOOD_BURST; burst++)
+      {
+        sendFlood();
+        nextFlood += 1e6 / options.floodRate;
+      }
+      if(now - nextFlood > 1e6)
+        nextFlood = now;
+    }
+
+    dwTime_t wake = now + SIM_CONFIG_POLL_US;
+    if(period > 0)
+      wake = std::min(wake, sendAt);
+    if(options.floodRate > 0)
+      wake = std::min(wake, static_cast<dwTime_t>(nextFlood));
+    if(wake > elapsed())
+      std::this_thread::sleep_until(start + std::chrono::microseconds(wake));
+  }
+}
+
+//----------------------------------------------------------------------------//
@@ -0,0 +1,128 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#ifndef OPENIMU300_SIMULATOR_H_
+#define OPENIMU300_SIMULATOR_H_
+
+#include <can_transport.h>
+#include <atomic>
+#include <random>
+
+#define SIM_BASE_PERIOD_US      10000   // 100Hz, packetRate divides this rate like the real sensor
+#define SIM_MEASUREMENT_LATENCY 4       // Reported latency, 0.5ms/bit
+
+// packetType bits selecting the periodic data packets
+#define SIM_PACKET_SSI1         0x01
+#define SIM_PACKET_RATE         0x02
+#define SIM_PACKET_ACCEL        0x04
+#define SIM_PACKET_MAG          0x08
+
+typedef struct{
+  uint8_t   address;          // Source address of the data packets, ECU address of config packets
+  uint16_t  packetRate;       // Divider of the base rate, 0 stops output
+  uint16_t  packetType;       // SIM_PACKET_* bits
+  dwTime_t  basePeriod_us;    // Below SIM_BASE_PERIOD_US to run faster than the real sensor
+  dwTime_t  jitter_us;        // Each sample is sent up to this late
+  double    dropRate;         // Probability a data packet is not sent
+  double    floodRate;        // Messages per second from other nodes
+  uint32_t  seed;
+}simulatorOptions_t;
+
+typedef struct{
+  uint64_t  samples;          // Sample periods elapsed
+  uint64_t  sent;             // Data packets sent
+  uint64_t  dropped;          // Data packets dropped on purpose
+  uint64_t  flooded;          // Foreign messages sent
+  uint64_t  configApplied;    // Configuration messages accepted
+  uint64_t  readbacks;        // Requests for a configuration PGN answered
+  uint64_t  saves;            // Save configuration requests answered
+}simulatorStats_t;
+
+// Simulated OpenIMU300 on a CAN transport.
+//
+// Sends the SSI1, angular rate, accel and magnetometer PGNs selected by
+// packetType at the rate set by packetRate, and applies the configuration
+// messages the plugin builds (packet rate and type, filters, orientation,
+// algorithm reset) as well as Bank of PS remapping, and answers requests for
+// the configuration PGNs with the current settings and save configuration
+// requests (nothing is stored). A slow rotation about the
+// yaw axis with gravity on z is reported.
+//
+// Use SocketCANTransport to run against vcan, or SALCANTransport on a
+// DriveWorks stand-in sensor to share an in-process bus with the plugin.
+class OpenIMU300Simulator
+{
+  public:
+    OpenIMU300Simulator(CANTransport *bus, const simulatorOptions_t &options);
+
+    static simulatorOptions_t defaultOptions();
+
+    // Runs until stop() or, if duration_us > 0, for that long
+    void run(dwTime_t duration_us = 0);
+
+    // Ends run(), also if called before run() started
+    void stop();
+
+    // Applies a message addressed to the sensor, returns true if accepted
+    bool handleMessage(const dwCANMessage &message);
+
+    simulatorStats_t getStats() const;
+
+    // Current configuration, only stable once run() returned
+    uint16_t getPacketRate() const
+    {
+      return options.packetRate;
+    }
+
+    uint16_t getPacketType() const
+    {
+      return options.packetType;
+    }
+
+  private:
+    typedef enum{
+      SIM_PS_RESET_ALGORITHM,
+      SIM_PS_PACKET_RATE,
+      SIM_PS_PACKET_TYPE,
+      SIM_PS_FILTER_FREQ,
+      SIM_PS_ORIENTATION,
+      SIM_PS_MAX,
+    }simulatorPS_t;
+
+    void sendSample(dwTime_t sampleTime_us);
+
+    void sendFlood();
+
+    bool answerRequest(uint8_t pf, uint8_t ps);
+
+    void buildMessage(uint8_t pf, uint8_t ps, dwCANMessage *message);
+
+    CANTransport                  *bus;
+    simulatorOptions_t            options;
+    std::atomic<bool>             stopRequested;
+    uint8_t                       configPS[SIM_PS_MAX];     // Remappable PS of the config PGNs
+    uint8_t                       rateLPF;
+    uint8_t                       accelLPF;
+    uint16_t                      orientation;
+    std::mt19937                  rng;
+
+    std::atomic<uint64_t>         samples;
+    std::atomic<uint64_t>         sent;
+    std::atomic<uint64_t>         dropped;
+    std::atomic<uint64_t>         flooded;
+    std::atomic<uint64_t>         configApplied;
+    std::atomic<uint64_t>         readbacks;
+    std::atomic<uint64_t>         saves;
+};
+
+#endif // OPENIMU300_SIMULATOR_H_
@@ -0,0 +1,106 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Simulated OpenIMU300 on a SocketCAN interface, e.g. vcan for testing the
+// plugin with can-proto=can.native or can.socket without a sensor.
+//
+// Usage: openimu300_sim --device=vcan0 [--address=128] [--packetRate=1]
+//                       [--packetType=15] [--basePeriod=us] [--jitter=us]
+//                       [--drop=probability] [--flood=msg/s] [--duration=ms]
+
+#include "openimu300_simulator.h"
+#include <socketcan_transport.h>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static OpenIMU300Simulator *activeSimulator = nullptr;
+
+static void onSignal(int)
+{
+  if(activeSimulator != nullptr)
+    activeSimulator->stop();
+}
+
+static bool getOption(const std::string &arg, const char *name, std::string *value)
+{
+  std::string prefix = std::string("--") + name + "=";
+  if(arg.compare(0, prefix.length(), prefix) != 0)
+    return false;
+  *value = arg.substr(prefix.length());
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  simulatorOptions_t options = OpenIMU300Simulator::defaultOptions();
+  std::string device;
+  dwTime_t duration_us = 0;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i], value;
+    if(getOption(arg, "device", &value))
+      device = value;
+    else if(getOption(arg, "address", &value))
+      options.address = static_cast<uint8_t>(strtoul(value.c_str(), nullptr, 0));
+    else if(getOption(arg, "packetRate", &value))
+      options.packetRate = static_cast<uint16_t>(strtoul(value.c_str(), nullptr, 0));
+    else if(getOption(arg, "packetType", &value))
+      options.packetType = static_cast<uint16_t>(strtoul(value.c_str(), nullptr, 0));
+    else if(getOption(arg, "basePeriod", &value))
+      options.basePeriod_us = strtoll(value.c_str(), nullptr, 10);
+    else if(getOption(arg, "jitter", &value))
+      options.jitter_us = strtoll(value.c_str(), nullptr, 10);
+    else if(getOption(arg, "drop", &value))
+      options.dropRate = strtod(value.c_str(), nullptr);
+    else if(getOption(arg, "flood", &value))
+      options.floodRate = strtod(value.c_str(), nullptr);
+    else if(getOption(arg, "duration", &value))
+      duration_us = strtoll(value.c_str(), nullptr, 10) * 1000;
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " --device=<if> [--address=] [--packetRate=] [--packetType=]"
+                << " [--basePeriod=us] [--jitter=us] [--drop=p] [--flood=msg/s] [--duration=ms]\n";
+      return 1;
+    }
+  }
+
+  if(device.empty() || options.basePeriod_us <= 0)
+  {
+    std::cerr << "A --device and a positive --basePeriod are required\n";
+    return 1;
+  }
+
+  SocketCANTransport transport;
+  if(transport.open(device) != DW_SUCCESS || transport.start() != DW_SUCCESS)
+    return 1;
+
+  OpenIMU300Simulator simulator(&transport, options);
+  activeSimulator = &simulator;
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  simulator.run(duration_us);
+
+  simulatorStats_t stats = simulator.getStats();
+  std::cout << "samples " << stats.samples << ", sent " << stats.sent << ", dropped " << stats.dropped
+            << ", flooded " << stats.flooded << ", config applied " << stats.configApplied
+            << ", readbacks " << stats.readbacks << ", saves " << stats.saves
+            << ", packetRate " << simulator.getPacketRate() << ", packetType " << simulator.getPacketType() << std::endl;
+
+  transport.stop();
+  transport.release();
+  return 0;
+}
@@ -0,0 +1,291 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <can_recorder.h>
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+
+CANRecorder::CANRecorder()
+: file(nullptr)
+, running(false)
+, dropped(0)
+, lastTimestamp(0)
+{ }
+
+//----------------------------------------------------------------------------//
+
+CANRecorder::~CANRecorder()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus CANRecorder::open(const std::string &path)
+{
+  close();
+
+  file = fopen(path.c_str(), "wb");
+  if(file == nullptr)
+  {
+    std::cerr << "CANRecorder: cannot create " << path << ", " << strerror(errno) << std::endl;
+    return DW_FILE_NOT_FOUND;
+  }
+  if(fwrite(CAN_RECORDER_MAGIC, 1, CAN_RECORDER_MAGIC_SIZE, file) != CAN_RECORDER_MAGIC_SIZE)
+  {
+    std::cerr << "CANRecorder: cannot write " << path << std::endl;
+    fclose(file);
+    file = nullptr;
+    return DW_FAILURE;
+  }
+
+  front.clear();
+  back.clear();
+  front.reserve(CAN_RECORDER_BUFFER_SIZE);
+  back.reserve(CAN_RECORDER_BUFFER_SIZE);
+  ids.clear();
+  lastTimestamp = 0;
+  dropped       = 0;
+
+  running = true;
+  writer  = std::thread(&CANRecorder::writerLoop, this);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void CANRecorder::close()
+{
+  if(file == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    running = false;
+  }
+  signal.notify_one();
+  if(writer.joinable())
+    writer.join();
+
+  fclose(file);
+  file = nullptr;
+
+  if(dropped > 0)
+    std::cerr << "CANRecorder: " << dropped << " messages dropped, disk too slow\n";
+}
+
+//----------------------------------------------------------------------------//
+
+size_t CANRecorder::encode(const dwCANMessage &message, uint8_t *out)
+{
+  size_t length = 0;
+
+  // Timestamp delta, zigzag so out of order timestamps stay small
+  int64_t  delta  = static_cast<int64_t>(message.timestamp_us - lastTimestamp);
+  uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+  while(zigzag >= 0x80)
+  {
+    out[length++] = static_cast<uint8_t>(zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  out[length++] = static_cast<uint8_t>(zigzag);
+
+  // Id as index into the table of ids seen so far
+  size_t index = 0;
+  while(index < ids.size() && ids[index] != message.id)
+    index++;
+
+  if(index < ids.size())
+  {
+    out[length++] = static_cast<uint8_t>(index);
+  }
+  else
+  {
+    out[length++] = CAN_RECORDER_ID_ESCAPE;
+    for(int i = 0; i < 4; i++)
+      out[length++] = static_cast<uint8_t>(message.id >> (8 * i));
+    if(ids.size() < CAN_RECORDER_ID_ESCAPE)
+      ids.push_back(message.id);
+  }
+
+  uint16_t size = message.size;
+  if(size > DW_SENSORS_CAN_MAX_MESSAGE_LEN)
+    size = DW_SENSORS_CAN_MAX_MESSAGE_LEN;
+  out[length++] = static_cast<uint8_t>(size);
+  memcpy(&out[length], message.data, size);
+  return length + size;
+}
+
+//----------------------------------------------------------------------------//
+
+bool CANRecorder::record(const dwCANMessage &message)
+{
+  if(file == nullptr)
+    return false;
+
+  // The encoded record depends on the id table, which must stay in sync with
+  // what reaches the file, so check for space before encoding
+  std::unique_lock<std::mutex> guard(lock);
+  if(front.size() + CAN_RECORDER_MAX_RECORD > CAN_RECORDER_BUFFER_SIZE)
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  uint8_t encoded[CAN_RECORDER_MAX_RECORD];
+  size_t  length = encode(message, encoded);
+  front.insert(front.end(), encoded, encoded + length);
+  lastTimestamp = message.timestamp_us;
+
+  bool wake = front.size() >= CAN_RECORDER_BUFFER_SIZE / 2;
+  guard.unlock();
+  if(wake)
+    signal.notify_one();
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+void CANRecorder::writerLoop()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while(true)
+  {
+    signal.wait_for(guard, std::chrono::microseconds(CAN_RECORDER_FLUSH_US), [this]{
+      return !running || front.size() >= CAN_RECORDER_BUFFER_SIZE / 2;
+    });
+
+    bool stopping = !running;
+    front.swap(back);
+
+    // Disk write without the lock, record() keeps filling the other buffer
+    guard.unlock();
+    if(!back.empty())
+    {
+      if(fwrite(back.data(), 1, back.size(), file) != back.size())
+        std::cerr << "CANRecorder: write failed, " << strerror(errno) << std::endl;
+      fflush(file);
+      back.clear();
+    }
+    guard.lock();
+
+    if(stopping && front.empty())
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+bool CANRecorder::isRecording(const uint8_t *data, size_t size)
+{
+  return size >= CAN_RECORDER_MAGIC_SIZE && memcmp(data, CAN_RECORDER_MAGIC, CAN_RECORDER_MAGIC_SIZE) == 0;
+}
+
+//----------------------------------------------------------------------------//
+
+// Decodes the record at *pos. Returns DW_END_OF_STREAM if the data ends
+// inside the record, which is left unconsumed.
+static dwStatus decodeRecord(const uint8_t *data, size_t size, size_t *pos, std::vector<uint32_t> *table,
+                             dwTime_t *timestamp, dwCANMessage *message)
+{
+  size_t p = *pos;
+  memset(message, 0, sizeof(*message));
+
+  uint64_t zigzag = 0;
+  int      shift  = 0;
+  while(true)
+  {
+    if(p >= size)
+      return DW_END_OF_STREAM;
+    if(shift > 63)
+      return DW_FILE_INVALID;
+    uint8_t byte = data[p++];
+    zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    shift  += 7;
+    if((byte & 0x80) == 0)
+      break;
+  }
+
+  if(p >= size)
+    return DW_END_OF_STREAM;
+  uint8_t index = data[p++];
+  if(index == CAN_RECORDER_ID_ESCAPE)
+  {
+    if(p + 4 > size)
+      return DW_END_OF_STREAM;
+    for(int i = 0; i < 4; i++)
+      message->id |= static_cast<uint32_t>(data[p++]) << (8 * i);
+  }
+  else
+  {
+    if(index >= table->size())
+      return DW_FILE_INVALID;
+    message->id = (*table)[index];
+  }
+
+  if(p >= size)
+    return DW_END_OF_STREAM;
+  message->size = data[p++];
+  if(message->size > DW_SENSORS_CAN_MAX_MESSAGE_LEN)
+    return DW_FILE_INVALID;
+  if(p + message->size > size)
+    return DW_END_OF_STREAM;
+  memcpy(message->data, &data[p], message->size);
+  p += message->size;
+
+  // Only a complete record changes the decoder state
+  if(index == CAN_RECORDER_ID_ESCAPE && table->size() < CAN_RECORDER_ID_ESCAPE)
+    table->push_back(message->id);
+  *timestamp            += static_cast<dwTime_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+  message->timestamp_us  = *timestamp;
+  *pos = p;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus CANRecorder::decode(const uint8_t *data, size_t size, std::vector<dwCANMessage> *messages, size_t *truncated)
+{
+  if(truncated)
+    *truncated = 0;
+  if(!isRecording(data, size))
+    return DW_FILE_INVALID;
+
+  std::vector<uint32_t> table;
+  dwTime_t timestamp = 0;
+  size_t   pos       = CAN_RECORDER_MAGIC_SIZE;
+
+  messages->clear();
+  while(pos < size)
+  {
+    dwCANMessage message;
+    dwStatus status = decodeRecord(data, size, &pos, &table, &timestamp, &message);
+    if(status == DW_END_OF_STREAM)
+    {
+      // Last record cut short, e.g. by a crash or power loss while recording
+      if(truncated)
+        *truncated = size - pos;
+      break;
+    }
+    if(status != DW_SUCCESS)
+      return status;
+
+    messages->push_back(message);
+  }
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
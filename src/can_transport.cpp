@@ -0,0 +1,76 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <can_transport.h>
+
+//----------------------------------------------------------------------------//
+
+SALCANTransport::SALCANTransport(dwSensorHandle_t canSensor)
+: canSensor(canSensor)
+{ }
+
+//----------------------------------------------------------------------------//
+
+SALCANTransport::~SALCANTransport()
+{ }
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::start()
+{
+  return dwSensor_start(canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::stop()
+{
+  return dwSensor_stop(canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::reset()
+{
+  return dwSensor_reset(canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::release()
+{
+  return dwSAL_releaseSensor(canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::readMessage(dwCANMessage *message, dwTime_t timeout_us)
+{
+  return dwSensorCAN_readMessage(message, timeout_us, canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::sendMessage(const dwCANMessage *message, dwTime_t timeout_us)
+{
+  return dwSensorCAN_sendMessage(message, timeout_us, canSensor);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SALCANTransport::setFilters(const canMessageFilter *, uint8_t)
+{
+  return DW_NOT_SUPPORTED;
+}
+
+//----------------------------------------------------------------------------//
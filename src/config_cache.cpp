@@ -0,0 +1,160 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <config_cache.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+
+#define FNV_OFFSET_BASIS      0xCBF29CE484222325ULL
+#define FNV_PRIME             0x100000001B3ULL
+
+#define CONFIG_CACHE_LINE     512
+
+// Sensors of the process sharing a cache file update it one at a time
+static std::mutex cacheLock;
+
+//----------------------------------------------------------------------------//
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t size)
+{
+  for(size_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+//----------------------------------------------------------------------------//
+
+// Hashed byte by byte in a fixed order, independent of struct padding and
+// host byte order
+uint64_t configFingerprint(const configStep_t *steps, uint8_t count)
+{
+  uint8_t version = CONFIG_CACHE_VERSION;
+  uint64_t hash   = fnv1a(FNV_OFFSET_BASIS, &version, 1);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    const dwCANMessage &message = steps[i].message;
+    uint8_t header[5] = {static_cast<uint8_t>(message.id >> 24), static_cast<uint8_t>(message.id >> 16),
+                         static_cast<uint8_t>(message.id >> 8),  static_cast<uint8_t>(message.id),
+                         static_cast<uint8_t>(message.size)};
+    hash = fnv1a(hash, header, sizeof(header));
+    hash = fnv1a(hash, message.data, std::min<size_t>(message.size, sizeof(message.data)));
+  }
+  return hash;
+}
+
+//----------------------------------------------------------------------------//
+
+static bool parseEntry(const char *line, char *bus, unsigned *address, uint64_t *fingerprint)
+{
+  return sscanf(line, "%255s %x %" SCNx64, bus, address, fingerprint) == 3;
+}
+
+//----------------------------------------------------------------------------//
+
+bool ConfigCache::contains(const std::string &bus, uint8_t imuAddress, uint64_t fingerprint) const
+{
+  std::lock_guard<std::mutex> guard(cacheLock);
+
+  FILE *file = fopen(path.c_str(), "r");
+  if(file == nullptr)
+    return false;
+
+  bool found = false;
+  char line[CONFIG_CACHE_LINE];
+  while(!found && fgets(line, sizeof(line), file) != nullptr)
+  {
+    char entryBus[256];
+    unsigned address = 0;
+    uint64_t entry   = 0;
+    found = parseEntry(line, entryBus, &address, &entry) && bus == entryBus && address == imuAddress
+         && entry == fingerprint;
+  }
+  fclose(file);
+  return found;
+}
+
+//----------------------------------------------------------------------------//
+
+bool ConfigCache::store(const std::string &bus, uint8_t imuAddress, uint64_t fingerprint)
+{
+  return update(bus, imuAddress, &fingerprint);
+}
+
+//----------------------------------------------------------------------------//
+
+bool ConfigCache::erase(const std::string &bus, uint8_t imuAddress)
+{
+  return update(bus, imuAddress, nullptr);
+}
+
+//----------------------------------------------------------------------------//
+
+// Copies the entries of the other IMUs to a temporary file, appends the new
+// entry and renames it over the cache
+bool ConfigCache::update(const std::string &bus, uint8_t imuAddress, const uint64_t *fingerprint)
+{
+  if(bus.empty() || bus.size() >= 256 || bus.find_first_of(" \t\n") != std::string::npos)
+  {
+    std::cerr << "ConfigCache: cannot key an entry by bus \"" << bus << "\"" << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(cacheLock);
+
+  std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+  FILE *out = fopen(temporary.c_str(), "w");
+  if(out == nullptr)
+  {
+    std::cerr << "ConfigCache: cannot create " << temporary << ", " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  FILE *in = fopen(path.c_str(), "r");
+  if(in != nullptr)
+  {
+    char line[CONFIG_CACHE_LINE];
+    while(fgets(line, sizeof(line), in) != nullptr)
+    {
+      char entryBus[256];
+      unsigned address = 0;
+      uint64_t entry   = 0;
+      if(!parseEntry(line, entryBus, &address, &entry) || (bus == entryBus && address == imuAddress))
+        continue;
+      fprintf(out, "%s 0x%02x %016" PRIx64 "\n", entryBus, address, entry);
+    }
+    fclose(in);
+  }
+
+  if(fingerprint != nullptr)
+    fprintf(out, "%s 0x%02x %016" PRIx64 "\n", bus.c_str(), imuAddress, *fingerprint);
+
+  bool written = (fflush(out) == 0);
+  written = (fclose(out) == 0) && written;
+  if(!written || rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    std::cerr << "ConfigCache: cannot write " << path << ", " << strerror(errno) << std::endl;
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
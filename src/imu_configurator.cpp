@@ -0,0 +1,627 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <imu_configurator.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+//----------------------------------------------------------------------------//
+
+const char* configStatusName(configStatus_t status)
+{
+  switch(status)
+  {
+    case CONFIG_NOT_SENT:     return "not sent";
+    case CONFIG_VERIFIED:     return "verified";
+    case CONFIG_UNVERIFIED:   return "sent, not verified";
+    case CONFIG_MISMATCH:     return "read back with another value";
+    case CONFIG_NO_RESPONSE:  return "no response";
+    case CONFIG_SEND_FAILED:  return "send failed";
+    case CONFIG_UNCHANGED:    return "already set, not sent";
+    case CONFIG_CACHED:       return "unchanged since the cached configuration, not sent";
+  }
+  return "unknown";
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus IMUConfigurator::run(const configStep_t *steps, uint8_t count, configStepResult_t *results, bool onlyChanges)
+{
+  bool pending[CONFIG_MAX_STEPS];
+  bool send[CONFIG_MAX_STEPS];
+  count = std::min(count, static_cast<uint8_t>(CONFIG_MAX_STEPS));
+
+  for(size_t i = 0; i < count; i++)
+  {
+    results[i].status   = CONFIG_NOT_SENT;
+    results[i].attempts = 0;
+    send[i]             = true;
+  }
+
+  if(onlyChanges)
+    probe(steps, count, send, results);
+
+  // Stages in increasing order, steps of a stage keep their order
+  int stage = -1;
+  while(true)
+  {
+    int next = INT_MAX;
+    for(size_t i = 0; i < count; i++)
+    {
+      if(send[i] && steps[i].stage > stage && steps[i].stage < next)
+        next = steps[i].stage;
+    }
+    if(next == INT_MAX)
+      break;
+
+    stage = next;
+    for(size_t i = 0; i < count; i++)
+    {
+      pending[i] = send[i] && (steps[i].stage == stage);
+    }
+    runStage(steps, count, pending, results);
+  }
+
+  for(size_t i = 0; i < count; i++)
+  {
+    if(results[i].status == CONFIG_SEND_FAILED)
+      return DW_FAILURE;
+  }
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+static bool isAnswerTo(const configReadback_t &readback, const dwCANMessage &message)
+{
+  return ((message.id ^ readback.responseId) & readback.responseMask) == 0;
+}
+
+//----------------------------------------------------------------------------//
+
+static bool matchesExpected(const configReadback_t &readback, const dwCANMessage &message)
+{
+  for(size_t i = 0; i < sizeof(readback.expected); i++)
+  {
+    if(readback.expectedMask[i] == 0)
+      continue;
+    if(i >= message.size || ((message.data[i] ^ readback.expected[i]) & readback.expectedMask[i]) != 0)
+      return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+static bool isSameRequest(const dwCANMessage &a, const dwCANMessage &b)
+{
+  return a.id == b.id && a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+//----------------------------------------------------------------------------//
+
+void IMUConfigurator::readBack(const configStep_t *steps, uint8_t count, const bool *ask, readbackOutcome_t *outcomes)
+{
+  typedef std::chrono::steady_clock clock;
+
+  // [step][readback] still expecting an answer, one request per distinct PGN
+  bool   awaiting[CONFIG_MAX_STEPS][CONFIG_STEP_MAX_READBACKS] = {};
+  bool   mismatch[CONFIG_MAX_STEPS]                            = {};
+  bool   unsent[CONFIG_MAX_STEPS]                              = {};
+  const dwCANMessage *sent[CONFIG_MAX_STEPS * CONFIG_STEP_MAX_READBACKS];
+  size_t sentCount = 0;
+  size_t waiting   = 0;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    for(size_t r = 0; ask[i] && r < steps[i].readbackCount; r++)
+    {
+      const dwCANMessage &request = steps[i].readbacks[r].request;
+      bool duplicate = false;
+      for(size_t j = 0; j < sentCount && !duplicate; j++)
+      {
+        duplicate = isSameRequest(*sent[j], request);
+      }
+
+      if(request.size > 0 && !duplicate)
+      {
+        // A readback nobody was asked for confirms nothing
+        if(transport->sendMessage(&request, CONFIG_SEND_TIMEOUT_US) != DW_SUCCESS)
+        {
+          unsent[i] = true;
+          continue;
+        }
+        sent[sentCount++] = &request;
+      }
+      awaiting[i][r] = true;
+      waiting++;
+    }
+  }
+
+  // Answers in any order, one answer may serve readbacks of several steps
+  auto deadline = clock::now() + std::chrono::microseconds(readbackTimeout_us);
+  while(waiting > 0)
+  {
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now()).count();
+    if(remaining <= 0)
+      break;
+
+    dwCANMessage message;
+    dwStatus status = transport->readMessage(&message, remaining);
+    if(status == DW_TIME_OUT)
+      continue;
+    if(status != DW_SUCCESS)
+      break;
+
+    for(size_t i = 0; i < count; i++)
+    {
+      for(size_t r = 0; r < steps[i].readbackCount; r++)
+      {
+        if(!awaiting[i][r] || !isAnswerTo(steps[i].readbacks[r], message))
+          continue;
+
+        awaiting[i][r] = false;
+        waiting--;
+        mismatch[i] = mismatch[i] || !matchesExpected(steps[i].readbacks[r], message);
+      }
+    }
+  }
+
+  for(size_t i = 0; i < count; i++)
+  {
+    bool missing = unsent[i] || std::find(awaiting[i], awaiting[i] + CONFIG_STEP_MAX_READBACKS, true)
+                             != awaiting[i] + CONFIG_STEP_MAX_READBACKS;
+    outcomes[i] = mismatch[i] ? READBACK_MISMATCH : (missing ? READBACK_MISSING : READBACK_MATCH);
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+// Only settings the sensor can be asked for are probed, steps whose answer
+// comes by itself (e.g. a save) are always sent
+void IMUConfigurator::probe(const configStep_t *steps, uint8_t count, bool *send, configStepResult_t *results)
+{
+  bool ask[CONFIG_MAX_STEPS] = {};
+  readbackOutcome_t outcomes[CONFIG_MAX_STEPS];
+
+  for(size_t i = 0; i < count; i++)
+  {
+    ask[i] = steps[i].readbackCount > 0;
+    for(size_t r = 0; r < steps[i].readbackCount; r++)
+    {
+      ask[i] = ask[i] && steps[i].readbacks[r].request.size > 0;
+    }
+  }
+
+  readBack(steps, count, ask, outcomes);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    if(ask[i] && outcomes[i] == READBACK_MATCH)
+    {
+      results[i].status = CONFIG_UNCHANGED;
+      send[i]           = false;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+void IMUConfigurator::runStage(const configStep_t *steps, uint8_t count, bool *pending, configStepResult_t *results)
+{
+  for(uint32_t attempt = 0; attempt < maxAttempts; attempt++)
+  {
+    readbackOutcome_t outcomes[CONFIG_MAX_STEPS];
+
+    // Pipelined: every message of the stage, then every readback request
+    for(size_t i = 0; i < count; i++)
+    {
+      if(!pending[i])
+        continue;
+
+      results[i].attempts++;
+      if(transport->sendMessage(&steps[i].message, CONFIG_SEND_TIMEOUT_US) != DW_SUCCESS)
+      {
+        results[i].status = CONFIG_SEND_FAILED;
+        pending[i]        = false;
+      }
+      else if(!verify || steps[i].readbackCount == 0)
+      {
+        results[i].status = CONFIG_UNVERIFIED;
+        pending[i]        = false;
+      }
+    }
+
+    readBack(steps, count, pending, outcomes);
+
+    for(size_t i = 0; i < count; i++)
+    {
+      if(!pending[i])
+        continue;
+
+      switch(outcomes[i])
+      {
+        case READBACK_MATCH:
+          results[i].status = CONFIG_VERIFIED;
+          pending[i]        = false;
+          break;
+        case READBACK_MISMATCH:
+          results[i].status = CONFIG_MISMATCH;
+          break;
+        case READBACK_MISSING:
+          results[i].status = CONFIG_NO_RESPONSE;
+          break;
+      }
+    }
+
+    if(std::find(pending, pending + count, true) == pending + count)
+      return;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+RuntimeConfigurator::RuntimeConfigurator(dwTime_t readbackTimeout_us, uint32_t maxAttempts)
+: readbackTimeout_us(readbackTimeout_us)
+, maxAttempts(maxAttempts)
+, active(false)
+, confirmedTimestamp_us(0)
+, lastAnswer_us(0)
+, imu(nullptr)
+, count(0)
+, status()
+, oldPeriod_us(0)
+, rateSeen(false)
+, trackedCount(0)
+{
+  status.state     = RECONFIG_IDLE;
+  status.period_us = -1;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus RuntimeConfigurator::submit(IMU *imu, const configStep_t *steps, uint8_t count, dwTime_t newPeriod_us)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if(status.state == RECONFIG_QUEUED || status.state == RECONFIG_SENT)
+    return DW_NOT_READY;
+
+  this->imu   = imu;
+  this->count = std::min(count, static_cast<uint8_t>(CONFIG_MAX_STEPS));
+  std::copy(steps, steps + this->count, this->steps);
+
+  uint32_t sequence = status.sequence + 1;
+  status            = {};
+  status.sequence   = sequence;
+  status.period_us  = newPeriod_us;
+  for(size_t i = 0; i < this->count; i++)
+  {
+    results[i] = {CONFIG_NOT_SENT, 0};
+    pending[i] = true;
+    for(uint8_t param = 0; param < 32; param++)
+    {
+      if((steps[i].params & (1u << param)) == 0 || status.paramCount >= CONFIG_REPORT_MAX_PARAMS)
+        continue;
+      paramStep[status.paramCount]           = static_cast<uint8_t>(i);
+      status.params[status.paramCount++].name = imu->getConfigParamName(param);
+    }
+  }
+
+  submitted     = clock::now();
+  rateDeadline  = submitted + std::chrono::microseconds(RECONFIG_RATE_TIMEOUT_US + 10 * std::max<dwTime_t>(newPeriod_us, 0));
+  oldPeriod_us  = imu->getDataPeriod();
+  rateSeen      = false;
+  trackedCount  = 0;
+  lastAnswer_us = 0;
+  setState(RECONFIG_QUEUED);
+  active.store(true, std::memory_order_release);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void RuntimeConfigurator::cancel()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  active.store(false, std::memory_order_release);
+  if(status.state == RECONFIG_QUEUED || status.state == RECONFIG_SENT)
+  {
+    commitConfirmed();
+    setState(RECONFIG_FAILED);
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+// Hands the parameters of the steps the sensor took to the IMU, the values of
+// the others are dropped
+void RuntimeConfigurator::commitConfirmed()
+{
+  uint32_t params = 0;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(!pending[i] && (results[i].status == CONFIG_VERIFIED || results[i].status == CONFIG_UNVERIFIED))
+      params |= steps[i].params;
+  }
+  imu->commitRuntimeConfig(params);
+}
+
+//----------------------------------------------------------------------------//
+
+bool RuntimeConfigurator::busy() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return status.state == RECONFIG_QUEUED || status.state == RECONFIG_SENT;
+}
+
+//----------------------------------------------------------------------------//
+
+void RuntimeConfigurator::getStatus(reconfigStatus_t *out) const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  *out = status;
+  for(size_t i = 0; i < status.paramCount; i++)
+  {
+    out->params[i].status   = results[paramStep[i]].status;
+    out->params[i].attempts = results[paramStep[i]].attempts;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+void RuntimeConfigurator::setState(reconfigState_t state)
+{
+  status.state = state;
+}
+
+//----------------------------------------------------------------------------//
+
+dwTime_t RuntimeConfigurator::sinceSubmit() const
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - submitted).count();
+}
+
+//----------------------------------------------------------------------------//
+
+void RuntimeConfigurator::serviceLocked(CANTransport *transport)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  switch(status.state)
+  {
+    case RECONFIG_QUEUED:
+      sendPending(transport);
+      break;
+    case RECONFIG_SENT:
+      if(clock::now() < deadline)
+        break;
+      finishAttempt();
+      if(status.state == RECONFIG_SENT)
+        sendPending(transport);
+      break;
+    case RECONFIG_CONFIRMED:
+      // New rate never seen, e.g. packetType=0, the change stays CONFIRMED
+      if(clock::now() >= rateDeadline)
+        active.store(false, std::memory_order_release);
+      break;
+    default:
+      active.store(false, std::memory_order_release);
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+// One attempt: the messages of the steps not confirmed yet, then their
+// readback requests, each distinct request once
+void RuntimeConfigurator::sendPending(CANTransport *transport)
+{
+  const dwCANMessage *sent[CONFIG_MAX_STEPS * CONFIG_STEP_MAX_READBACKS];
+  size_t sentCount = 0;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    if(!pending[i])
+      continue;
+
+    results[i].attempts++;
+    if(transport->sendMessage(&steps[i].message, RECONFIG_SEND_TIMEOUT_US) != DW_SUCCESS)
+    {
+      results[i].status = CONFIG_SEND_FAILED;
+    }
+    else if(steps[i].readbackCount == 0)
+    {
+      results[i].status = CONFIG_UNVERIFIED;
+      pending[i]        = false;
+    }
+    else
+    {
+      results[i].status = CONFIG_NO_RESPONSE;
+    }
+  }
+
+  for(size_t i = 0; i < count; i++)
+  {
+    mismatch[i] = false;
+    for(size_t r = 0; r < CONFIG_STEP_MAX_READBACKS; r++)
+    {
+      awaiting[i][r] = false;
+      if(!pending[i] || results[i].status == CONFIG_SEND_FAILED || r >= steps[i].readbackCount)
+        continue;
+
+      const dwCANMessage &request = steps[i].readbacks[r].request;
+      bool duplicate = false;
+      for(size_t j = 0; j < sentCount && !duplicate; j++)
+      {
+        duplicate = isSameRequest(*sent[j], request);
+      }
+      if(request.size > 0 && !duplicate)
+      {
+        if(transport->sendMessage(&request, RECONFIG_SEND_TIMEOUT_US) != DW_SUCCESS)
+          continue;
+        sent[sentCount++] = &request;
+      }
+      awaiting[i][r] = true;
+    }
+  }
+
+  deadline = clock::now() + std::chrono::microseconds(readbackTimeout_us);
+  setState(RECONFIG_SENT);
+}
+
+//----------------------------------------------------------------------------//
+
+// End of an attempt, all answers in or the readback timed out. Steps still
+// pending are sent again by the next service() unless out of attempts.
+void RuntimeConfigurator::finishAttempt()
+{
+  bool retry  = false;
+  bool failed = false;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(!pending[i])
+    {
+      failed = failed || (results[i].status != CONFIG_VERIFIED && results[i].status != CONFIG_UNVERIFIED);
+      continue;
+    }
+    if(results[i].attempts < maxAttempts)
+      retry = true;
+    else
+      failed = true;
+  }
+
+  if(retry && !failed)
+  {
+    deadline = clock::now();    // Resend at the next service()
+    return;
+  }
+
+  commitConfirmed();
+  if(failed)
+  {
+    setState(RECONFIG_FAILED);
+    active.store(false, std::memory_order_release);
+    return;
+  }
+
+  status.confirmed_us = sinceSubmit();
+  if(lastAnswer_us != 0)
+    confirmedTimestamp_us.store(lastAnswer_us, std::memory_order_release);
+  if(status.period_us < 0 || status.period_us == 0 || rateSeen)
+  {
+    // No rate to watch for, or output stopped, or the new rate came before the readback
+    if(status.period_us >= 0 && !rateSeen)
+    {
+      imu->setDataPeriod(status.period_us);
+      status.effective_us = status.confirmed_us;
+    }
+    setState(RECONFIG_EFFECTIVE);
+    active.store(false, std::memory_order_release);
+    return;
+  }
+  setState(RECONFIG_CONFIRMED);
+}
+
+//----------------------------------------------------------------------------//
+
+bool RuntimeConfigurator::filterLocked(const dwCANMessage &message)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  bool answer = false;
+
+  if(status.state == RECONFIG_SENT)
+  {
+    bool waiting = false;
+    for(size_t i = 0; i < count; i++)
+    {
+      bool stepWaiting = false;
+      bool stepAnswered = false;
+      for(size_t r = 0; r < steps[i].readbackCount; r++)
+      {
+        if(awaiting[i][r] && isAnswerTo(steps[i].readbacks[r], message))
+        {
+          awaiting[i][r] = false;
+          mismatch[i]    = mismatch[i] || !matchesExpected(steps[i].readbacks[r], message);
+          answer         = stepAnswered = true;
+          lastAnswer_us  = message.timestamp_us;
+        }
+        stepWaiting = stepWaiting || awaiting[i][r];
+      }
+
+      if(stepAnswered && !stepWaiting)
+      {
+        results[i].status = mismatch[i] ? CONFIG_MISMATCH : CONFIG_VERIFIED;
+        pending[i]        = mismatch[i];
+      }
+      waiting = waiting || stepWaiting;
+    }
+
+    if(answer && !waiting)
+      finishAttempt();
+  }
+
+  if(!answer && status.period_us > 0 && !rateSeen &&
+     (status.state == RECONFIG_SENT || status.state == RECONFIG_CONFIRMED))
+  {
+    trackRate(message);
+  }
+  return answer;
+}
+
+//----------------------------------------------------------------------------//
+
+// The new period is seen once RECONFIG_RATE_INTERVALS consecutive packets of
+// one PGN are that far apart. The tolerance stays below half the distance to
+// the old period, so packets still at the old rate never match, e.g. 40 and
+// 50 ms.
+void RuntimeConfigurator::trackRate(const dwCANMessage &message)
+{
+  size_t i = 0;
+  while(i < trackedCount && tracked[i].id != message.id)
+    i++;
+  if(i == trackedCount)
+  {
+    if(trackedCount == RECONFIG_TRACKED_IDS)
+      return;
+    tracked[trackedCount++] = {message.id, message.timestamp_us, 0, 0};
+    return;
+  }
+
+  trackedId_t &entry  = tracked[i];
+  dwTime_t interval   = message.timestamp_us - entry.last_us;
+  dwTime_t tolerance  = status.period_us / RECONFIG_RATE_TOLERANCE;
+  if(oldPeriod_us > 0 && oldPeriod_us != status.period_us)
+    tolerance = std::min(tolerance, (std::abs(status.period_us - oldPeriod_us) - 1) / 2);
+  entry.last_us       = message.timestamp_us;
+  if(interval < status.period_us - tolerance || interval > status.period_us + tolerance)
+  {
+    entry.matching = 0;
+    return;
+  }
+  if(entry.matching++ == 0)
+    entry.first_us = message.timestamp_us;
+  if(entry.matching < RECONFIG_RATE_INTERVALS)
+    return;
+
+  rateSeen                     = true;
+  status.effectiveTimestamp_us = entry.first_us;
+  status.effective_us          = sinceSubmit() - (message.timestamp_us - entry.first_us);
+  imu->setDataPeriod(status.period_us);
+  if(status.state == RECONFIG_CONFIRMED)
+  {
+    setState(RECONFIG_EFFECTIVE);
+    active.store(false, std::memory_order_release);
+  }
+}
@@ -13,11 +13,31 @@ limitations under the License.
 
 #include <dw/sensors/plugins/imu/IMUPlugin.h>
 #include <dw/sensors/canbus/CAN.h>
-#include <BufferPool.hpp>
-#include <ByteQueue.hpp>
 #include <iostream>
 #include <openimu300_plugin.h>
+#include <imu_frame_assembler.h>
+#include <can_transport.h>
+#include <socketcan_transport.h>
+#include <replay_transport.h>
+#include <shared_can_bus.h>
+#include <can_recorder.h>
+#include <spsc_ring.h>
+#include <message_pool.h>
+#include <handle_registry.h>
+#include <latency_histogram.h>
+#include <imu_plugin_stats.h>
+#include <imu_plugin_config.h>
+#include <imu_configurator.h>
+#include <config_cache.h>
+#include <plugin_stats.h>
 #include <unistd.h>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 using namespace std;
 namespace dw
 {
@@ -26,9 +46,9 @@ namespace plugins
 namespace imu
 {
 
-#define SRC_ADDRESS       (0x00)
-#define DEST_ADDRESS      (0x80)
-static OpenIMU300 instance(SRC_ADDRESS, DEST_ADDRESS);
+#define SRC_ADDRESS       (0x00)     // Default plugin source address, srcAddress=
+#define DEST_ADDRESS      (0x80)     // Default IMU (ECU) address, imuAddress=
+#define MAX_J1939_ADDRESS (0xFD)     // 0xFE is the null and 0xFF the global address
 
 // Structure defining sample CAN acceleration
 typedef struct
@@ -45,7 +65,31 @@ typedef struct
     int16_t gyroYaw;
 } SampleCANReportGyro;
 
-const size_t SAMPLE_BUFFER_POOL_SIZE = 5;
+const size_t SAMPLE_BUFFER_POOL_SIZE = 256;    // Default message slots, messages read and not yet parsed, poolSize=
+const size_t MAX_BUFFER_POOL_SIZE    = 4096;   // Bounds poolSize= and the parse queue, power of two
+const size_t READER_QUEUE_SIZE       = 1024;   // Valid messages read by the reader thread, power of two
+const dwTime_t READER_POLL_TIMEOUT_US = 10000; // Bounds how long stopSensor() waits for the reader thread
+const uint8_t MAX_MESSAGE_FILTERS    = 32;
+const size_t MAX_SENSOR_HANDLES      = 256;    // Sensors that can exist at the same time
+
+// What readRawData and pushData do when all message slots are in use, overflow=
+typedef enum
+{
+    OVERFLOW_BLOCK,         // Wait for a slot, nothing is dropped by the plugin
+    OVERFLOW_DROP_OLDEST,   // Reuse the slot of the oldest message not parsed yet
+    OVERFLOW_DROP_NEWEST,   // Discard incoming messages until a slot is free
+} overflowPolicy_t;
+
+// Counters of the overflow policy, only incremented when the pool is exhausted
+typedef struct
+{
+    uint64_t blocked;         // readRawData calls that waited for a slot
+    uint64_t blockTimeouts;   // Of which timed out without a slot
+    uint64_t rejected;        // pushData calls returning DW_BUFFER_FULL under the block policy
+    uint64_t droppedOldest;   // Queued messages discarded for newer ones
+    uint64_t droppedNewest;   // Incoming messages discarded
+    uint64_t readerDropped;   // Messages the reader thread read while its queue was full (readerThread=1)
+} overflowStats_t;
 
 class AceinnaIMUSensor
 {
@@ -55,14 +99,39 @@ public:
         , m_sal(nullptr)
         , m_canSensor(canSensor)
         , m_virtualSensorFlag(true)
-        , m_buffer(sizeof(dwCANMessage))
-        , m_slot(slotSize)
-        , imu(&instance)
+        , m_zeroCopyRead(false)
+        , m_queueByRef(false)
+        , m_pool(new MessagePool(slotSize))
+        , m_overflowPolicy(OVERFLOW_BLOCK)
+        , m_blocked(0)
+        , m_blockTimeouts(0)
+        , m_rejected(0)
+        , m_droppedOldest(0)
+        , m_droppedNewest(0)
+        , m_readerDropped(0)
+        , m_imuAddress(DEST_ADDRESS)
+        , imu(new OpenIMU300(SRC_ADDRESS, DEST_ADDRESS))
         , configMessages(nullptr)
+        , configCount(0)
+        , m_configVerify(true)
+        , m_configDiff(false)
+        , m_configSave(false)
+        , m_configReport()
+        , m_streaming_us(0)
+        , m_started(false)
+        , m_assembleFrames(false)
+        , m_relearnedAt_us(0)
+        , m_asyncRead(false)
+        , m_readerRunning(false)
+        , m_readerWaiting(false)
+        , m_readerEnded(false)
     {
     }
 
-    ~AceinnaIMUSensor() = default;
+    ~AceinnaIMUSensor()
+    {
+        stopReader();
+    }
 
     dwStatus createSensor(dwSALHandle_t sal, const char* params)
     {
@@ -83,25 +152,189 @@ public:
         pos                        = protocolString.find_first_of(",");
         protocolString             = protocolString.substr(0, pos);
 
-        // create CAN bus interface
-        dwSensorParams parameters{};
-        parameters.parameters = params;
-        parameters.protocol   = protocolString.c_str();
-
-        if (dwSAL_createSensor(&m_canSensor, parameters, m_sal) != DW_SUCCESS)
+        // Identifies the bus, e.g. to share its reader or key the configuration cache
+        std::string value;
+        m_busName = protocolString;
+        if (getPluginParameter(paramsString, "device=", &value) || getPluginParameter(paramsString, "file=", &value))
         {
-            std::cerr << "createSensor: Cannot create sensor "
-                      << parameters.protocol << " with " << parameters.parameters << std::endl;
+            m_busName += "," + value;
+        }
 
+        // Each sensor decodes with its own IMU object, addressed by srcAddress= and imuAddress=
+        uint8_t srcAddress = SRC_ADDRESS;
+        uint8_t imuAddress = DEST_ADDRESS;
+        if ((getPluginParameter(paramsString, "srcAddress=", &value) && !parseAddress(value, &srcAddress)) ||
+            (getPluginParameter(paramsString, "imuAddress=", &value) && !parseAddress(value, &imuAddress)))
+        {
+            std::cerr << "createSensor: J1939 addresses must be within [0, " << MAX_J1939_ADDRESS << "]\n";
             return DW_FAILURE;
         }
 
+        // Optional shared bus, one reader routes the messages of several IMUs by source address
+        dwStatus status;
+        if (getPluginParameter(paramsString, "sharedBus=", &value) && value == "1")
+        {
+            std::shared_ptr<SharedCANBus> bus = SharedCANBus::get(m_busName,
+                [&](std::unique_ptr<CANTransport>* transport) { return openTransport(protocolString, paramsString, transport); },
+                &status);
+            if (!bus)
+            {
+                return status;
+            }
+
+            std::unique_ptr<SharedBusTransport> transport(new SharedBusTransport(bus, imuAddress));
+            status = transport->attach();
+            if (status != DW_SUCCESS)
+            {
+                return status;
+            }
+            m_transport.reset(transport.release());
+        }
+        else
+        {
+            status = openTransport(protocolString, paramsString, &m_transport);
+            if (status != DW_SUCCESS)
+            {
+                return status;
+            }
+            m_zeroCopyRead = (protocolString == "can.replay");
+        }
+
+        // Optional frame assembly, merges the per packet frames of one sample epoch
+        if (getPluginParameter(paramsString, "frameAssembly=", &value))
+        {
+            m_assembleFrames = (value == "1");
+        }
+        if (getPluginParameter(paramsString, "frameTimeout=", &value))
+        {
+            m_assembler.setTimeout(static_cast<dwTime_t>(strtoul(value.c_str(), nullptr, 10)));
+        }
+
+        // Readback of the configuration at start, on by default
+        if (getPluginParameter(paramsString, "configVerify=", &value))
+        {
+            if (value != "0" && value != "1")
+            {
+                std::cerr << "createSensor: configVerify must be 0 or 1\n";
+                return DW_FAILURE;
+            }
+            m_configVerify = (value == "1");
+        }
+        if (getPluginParameter(paramsString, "configDiff=", &value))
+        {
+            if (value != "0" && value != "1")
+            {
+                std::cerr << "createSensor: configDiff must be 0 or 1\n";
+                return DW_FAILURE;
+            }
+            m_configDiff = (value == "1");
+        }
+        if (getPluginParameter(paramsString, "configSave=", &value))
+        {
+            if (value != "0" && value != "1")
+            {
+                std::cerr << "createSensor: configSave must be 0 or 1\n";
+                return DW_FAILURE;
+            }
+            m_configSave = (value == "1");
+        }
+        if (getPluginParameter(paramsString, "configCache=", &value))
+        {
+            m_configCache.reset(new ConfigCache(value));
+        }
+
+        // Optional reader thread, drains the CAN sensor independent of readRawData calls
+        if (getPluginParameter(paramsString, "readerThread=", &value))
+        {
+            m_asyncRead = (value == "1");
+        }
+
+        // Optional recording of the messages returned by readRawData
+        if (getPluginParameter(paramsString, "record=", &value))
+        {
+            m_recorder.reset(new CANRecorder());
+            status = m_recorder->open(value);
+            if (status != DW_SUCCESS)
+            {
+                m_recorder.reset();
+                return status;
+            }
+        }
+
+        // Message slots and what to do when they run out
+        if (getPluginParameter(paramsString, "poolSize=", &value))
+        {
+            unsigned long poolSize = strtoul(value.c_str(), nullptr, 10);
+            if (poolSize == 0 || poolSize > MAX_BUFFER_POOL_SIZE)
+            {
+                std::cerr << "createSensor: poolSize must be within [1, " << MAX_BUFFER_POOL_SIZE << "]\n";
+                return DW_FAILURE;
+            }
+            m_pool.reset(new MessagePool(poolSize));
+        }
+        if (getPluginParameter(paramsString, "zeroCopy=", &value))
+        {
+            m_queueByRef = (value == "1");
+        }
+        if (getPluginParameter(paramsString, "overflow=", &value))
+        {
+            if (value == "block")
+                m_overflowPolicy = OVERFLOW_BLOCK;
+            else if (value == "drop-oldest")
+                m_overflowPolicy = OVERFLOW_DROP_OLDEST;
+            else if (value == "drop-newest")
+                m_overflowPolicy = OVERFLOW_DROP_NEWEST;
+            else
+            {
+                std::cerr << "createSensor: overflow must be block, drop-oldest or drop-newest\n";
+                return DW_FAILURE;
+            }
+        }
+
+        // Optional periodic dump of the hot path statistics
+        if (getPluginParameter(paramsString, "statsFile=", &value))
+        {
+            std::string statsFile = value;
+            uint32_t period_ms    = PLUGIN_STATS_DEFAULT_PERIOD_MS;
+            if (getPluginParameter(paramsString, "statsPeriod=", &value))
+            {
+                period_ms = static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10));
+            }
+            if (period_ms == 0)
+            {
+                std::cerr << "createSensor: statsPeriod must be at least 1 ms\n";
+                return DW_FAILURE;
+            }
+
+            status = m_stats.dump(statsFile, period_ms);
+            if (status == DW_NOT_SUPPORTED)
+            {
+                std::cerr << "createSensor: statsFile ignored, plugin built without ENABLE_PLUGIN_STATS\n";
+            }
+            else if (status != DW_SUCCESS)
+            {
+                return status;
+            }
+        }
+
+        imu.reset(new OpenIMU300(srcAddress, imuAddress));
+        m_imuAddress = imuAddress;
+
         // Initialize IMU and get list of paramater strings supported and set parameter struct to default
         if(!imu->init(paramsString, &configMessages, &configCount))
         {
           return DW_FAILURE;
         }
 
+        // Let the transport drop foreign traffic if it can, PGNs are final after init()
+        canMessageFilter filters[MAX_MESSAGE_FILTERS];
+        uint8_t filterCount = imu->getMessageFilters(filters, MAX_MESSAGE_FILTERS);
+        status              = m_transport->setFilters(filters, filterCount);
+        if (status != DW_SUCCESS && status != DW_NOT_SUPPORTED)
+        {
+            return status;
+        }
+
 #if 0
         printf("Number of Config Messages %u \r\n", configCount);
         for(size_t i = 0; i < configCount; i++)
@@ -115,91 +348,104 @@ public:
     dwStatus startSensor()
     {
         dwStatus status;
+        m_startTime = std::chrono::steady_clock::now();
+        m_streaming_us.store(0, std::memory_order_relaxed);
         if (!isVirtualSensor())
         {
-          status = dwSensor_start(m_canSensor);
+          status = m_transport->start();
 
           if(status != DW_SUCCESS)
             return status;
           /*
           // Read & ingonre residual messages from preious run, if any.
           dwCANMessage ignore;
-          while (dwSensorCAN_readMessage(&ignore, 10000, m_canSensor) == DW_SUCCESS)
+          while (m_transport->readMessage(&ignore, 10000) == DW_SUCCESS)
           {
             printf("Reading residual \r\n");
           }
 
           dwCANMessage resetMessage;
           imu->getSensorResetMessage(&resetMessage);
-          if(dwSensorCAN_sendMessage(&resetMessage, 100000, m_canSensor) != DW_SUCCESS){
+          if(m_transport->sendMessage(&resetMessage, 100000) != DW_SUCCESS){
             return DW_FAILURE;
           }
           printf("restarting IMU\r\n");
           sleep(2);
           */
 
-          if(configMessages != nullptr)
+          status = configure();
+          if (status != DW_SUCCESS)
+            return status;
+
+          if (m_asyncRead)
           {
-            // Send Configuration messages to IMU
-            for(size_t i = 0; i < configCount; i++)
-            {
-              printf("configMessages[%lu].id = %X, %X %X %X %X %X %X %X %X\r\n", i, configMessages[i].id, configMessages[i].data[0], configMessages[i].data[1], configMessages[i].data[2], configMessages[i].data[3], configMessages[i].data[4], configMessages[i].data[5], configMessages[i].data[6], configMessages[i].data[7]);
-              if(dwSensorCAN_sendMessage(&configMessages[i], 100000, m_canSensor) != DW_SUCCESS)
-                return DW_FAILURE;
-            }
+            startReader();
           }
+          m_started = true;
         }
         return DW_SUCCESS;
     }
 
     dwStatus releaseSensor()
     {
-        if (!isVirtualSensor())
-            return dwSAL_releaseSensor(m_canSensor);
+        stopReader();
+        m_recorder.reset();
+        m_stats.stopDump();
+
+        overflowStats_t stats = getOverflowStats();
+        if (stats.blocked + stats.rejected + stats.droppedOldest + stats.droppedNewest + stats.readerDropped > 0)
+        {
+            std::cerr << "releaseSensor: message pool overflow, blocked " << stats.blocked
+                      << " (timed out " << stats.blockTimeouts << "), rejected " << stats.rejected
+                      << ", dropped oldest " << stats.droppedOldest << ", dropped newest " << stats.droppedNewest
+                      << ", dropped by reader thread " << stats.readerDropped << std::endl;
+        }
+
+        if (!isVirtualSensor() && m_transport)
+        {
+            dwStatus status = m_transport->release();
+            m_transport.reset();
+            return status;
+        }
 
         return DW_SUCCESS;
     }
 
     dwStatus stopSensor()
     {
-        if (!isVirtualSensor())
-            return dwSensor_stop(m_canSensor);
+        m_started = false;
+        stopReader();
+        m_reconfig.cancel();
+
+        if (!isVirtualSensor() && m_transport)
+            return m_transport->stop();
 
         return DW_SUCCESS;
     }
 
     dwStatus resetSensor()
     {
-        m_buffer.clear();
+        clearQueue();
+        m_rxBuffer.clear();
+        m_assembler.reset();
 
-        if (!isVirtualSensor())
-            return dwSensor_reset(m_canSensor);
+        if (!isVirtualSensor() && m_transport)
+            return m_transport->reset();
 
         return DW_SUCCESS;
     }
 
     dwStatus readRawData(const uint8_t** data, size_t* size, dwTime_t timeout_us)
     {
-        dwCANMessage* result = nullptr;
-        bool ok              = m_slot.get(result);    // Get an empty message slot from plugin's empty message pool
-        if (!ok)
+        auto start      = std::chrono::steady_clock::now();
+        auto deadline   = start + std::chrono::microseconds(timeout_us);
+        dwStatus status = readValidMessage(data, size, timeout_us, deadline);
+        if (status == DW_SUCCESS && m_recorder)
         {
-            std::cerr << "readRawData: Read raw data, slot not empty\n";
-            return DW_BUFFER_FULL;
+            m_recorder->record(*reinterpret_cast<const dwCANMessage*>(*data));
         }
-
-        // Read sensor raw data to provided message slot
-        while (dwSensorCAN_readMessage(result, timeout_us, (m_canSensor)) == DW_SUCCESS)
-        {
-          if(imu->isValidMessage(result->id))
-          {
-            break;
-          }
-        }
-
-        *data = reinterpret_cast<uint8_t*>(result);
-        *size = sizeof(dwCANMessage);
-        return DW_SUCCESS;
+        m_readLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        return status;
     }
 
     dwStatus returnRawData(const uint8_t* data)
@@ -209,7 +455,13 @@ public:
             return DW_INVALID_HANDLE;
         }
 
-        bool ok = m_slot.put(const_cast<dwCANMessage*>(reinterpret_cast<const dwCANMessage*>(data)));
+        if (m_transport && m_transport->ownsMessage(reinterpret_cast<const dwCANMessage*>(data)))
+        {
+            return DW_SUCCESS;
+        }
+
+        // The slot stays in use until parseData is done with it too
+        bool ok = m_pool->release(reinterpret_cast<const dwCANMessage*>(data));
 		    if (!ok)
         {
             std::cerr << "returnRawData: IMUPlugin return raw data, invalid data pointer" << std::endl;
@@ -222,38 +474,95 @@ public:
 
     dwStatus pushData(const uint8_t* data, const size_t size, size_t* lenPushed)
     {
-        //cout << "Pushing Data\r\n";
-        m_buffer.enqueue(data, size);
-        *lenPushed = size;
-        return DW_SUCCESS;
+        PluginStats::timestamp_t start = PluginStats::now();
+        dwStatus status                = pushMessages(data, size, lenPushed);
+        m_stats.record(PLUGIN_STAGE_PUSH, start);
+        return status;
     }
 
     dwStatus parseData(dwIMUFrame* frame, size_t* consumed)
     {
-        const dwCANMessage* reference;
-
-        if (!m_buffer.peek(reinterpret_cast<const uint8_t**>(&reference)))
+        PluginStats::timestamp_t start = PluginStats::now();
+        dwStatus status                = parseNext(frame, consumed);
+        if (status == DW_SUCCESS)
         {
-            return DW_NOT_AVAILABLE;
+            m_stats.record(PLUGIN_STAGE_EMIT, start);
+            if (m_streaming_us.load(std::memory_order_relaxed) == 0)
+            {
+                m_streaming_us.store(std::max<dwTime_t>(1, elapsedSinceStart()), std::memory_order_relaxed);
+            }
         }
+        return status;
+    }
 
-        if (consumed)
-            *consumed = sizeof(dwCANMessage);
+    overflowStats_t getOverflowStats() const
+    {
+        overflowStats_t stats;
+        stats.blocked       = m_blocked.load(std::memory_order_relaxed);
+        stats.blockTimeouts = m_blockTimeouts.load(std::memory_order_relaxed);
+        stats.rejected      = m_rejected.load(std::memory_order_relaxed);
+        stats.droppedOldest = m_droppedOldest.load(std::memory_order_relaxed);
+        stats.droppedNewest = m_droppedNewest.load(std::memory_order_relaxed);
+        stats.readerDropped = m_readerDropped.load(std::memory_order_relaxed);
+        return stats;
+    }
 
-        *frame              = {};
-        frame->timestamp_us = (*reference).timestamp_us;
+    uint8_t getIMUAddress() const
+    {
+        return m_imuAddress;
+    }
+
+    // Time spent in readRawData
+    void getReadLatency(latencyHistogram_t* histogram) const
+    {
+        m_readLatency.snapshot(histogram);
+    }
 
-        if(!imu->parseDataPacket(*reference, frame))
+    void getStats(pluginStats_t* stats) const
+    {
+        m_stats.snapshot(stats);
+    }
+
+    void getConfigReport(configReport_t* report) const
+    {
         {
-          m_buffer.dequeue();
-          return DW_FAILURE;
+            std::lock_guard<std::mutex> guard(m_configLock);
+            *report = m_configReport;
         }
+        report->streaming_us = m_streaming_us.load(std::memory_order_relaxed);
+    }
 
-        m_buffer.dequeue();
-        return DW_SUCCESS;
+    // Validates a runtime change and queues it for the reading thread
+    dwStatus reconfigure(const char* params)
+    {
+        if (isVirtualSensor() || m_zeroCopyRead || !m_started)
+            return DW_CALL_NOT_ALLOWED;
+
+        // The IMU keeps the values of an accepted change, so only one caller builds one at a time
+        std::lock_guard<std::mutex> guard(m_reconfigLock);
+        if (m_reconfig.busy())
+            return DW_NOT_READY;
+
+        configStep_t steps[CONFIG_MAX_STEPS];
+        uint8_t count = CONFIG_MAX_STEPS;
+        dwTime_t newPeriod_us;
+        if (!imu->getRuntimeConfigSteps(params, steps, &count, &newPeriod_us))
+            return DW_INVALID_ARGUMENT;
+
+        dwStatus status = m_reconfig.submit(imu.get(), steps, count, newPeriod_us);
+
+        // The IMU no longer runs the cached configuration, the next start must send it again
+        if (status == DW_SUCCESS && m_configCache)
+            m_configCache->erase(m_busName, m_imuAddress);
+        return status;
+    }
+
+    void getReconfigStatus(reconfigStatus_t* status) const
+    {
+        m_reconfig.getStatus(status);
     }
 
-    static std::vector<std::unique_ptr<dw::plugins::imu::AceinnaIMUSensor>> g_sensorContext;
+    static HandleRegistry<AceinnaIMUSensor, MAX_SENSOR_HANDLES> g_sensorRegistry;
 
 private:
     inline bool isVirtualSensor()
@@ -261,34 +570,789 @@ private:
         return m_virtualSensorFlag;
     }
 
+    dwTime_t elapsedSinceStart() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+    }
+
+    // Sends the configuration prepared by init(), pipelined and confirmed by
+    // readback, and keeps the outcome of each parameter for getConfigReport().
+    // With configCache= a configuration confirmed and saved on the IMU at an
+    // earlier start is not sent again.
+    dwStatus configure()
+    {
+        configStep_t steps[CONFIG_MAX_STEPS];
+        configStepResult_t results[CONFIG_MAX_STEPS];
+        uint8_t count        = imu->getConfigSteps(steps, CONFIG_MAX_STEPS);
+        uint64_t fingerprint = configFingerprint(steps, count);
+
+        dwStatus status = DW_SUCCESS;
+        bool cached     = count > 0 && m_configCache && m_configCache->contains(m_busName, m_imuAddress, fingerprint);
+        bool sent       = false;
+        if (cached)
+        {
+            for (size_t i = 0; i < count; i++)
+                results[i] = {CONFIG_CACHED, 0};
+        }
+        else
+        {
+            IMUConfigurator configurator(m_transport.get(), m_configVerify);
+            status = configurator.run(steps, count, results, m_configDiff);
+            for (size_t i = 0; i < count; i++)
+                sent = sent || results[i].attempts > 0;
+        }
+
+        configReport_t report = {};
+        uint32_t verified     = 0;
+        bool confirmed        = (status == DW_SUCCESS);
+        for (size_t i = 0; i < count; i++)
+        {
+            confirmed = confirmed && (results[i].status == CONFIG_VERIFIED || results[i].status == CONFIG_UNCHANGED);
+            for (uint8_t param = 0; param < 32; param++)
+            {
+                if ((steps[i].params & (1u << param)) == 0 || report.paramCount >= CONFIG_REPORT_MAX_PARAMS)
+                    continue;
+
+                configParamReport_t& entry = report.params[report.paramCount++];
+                entry.name                 = imu->getConfigParamName(param);
+                entry.status               = results[i].status;
+                entry.attempts             = results[i].attempts;
+                verified += (entry.status == CONFIG_VERIFIED || entry.status == CONFIG_UNCHANGED ||
+                             entry.status == CONFIG_CACHED);
+                if (entry.status == CONFIG_MISMATCH || entry.status == CONFIG_NO_RESPONSE ||
+                    entry.status == CONFIG_SEND_FAILED)
+                {
+                    std::cerr << "startSensor: " << entry.name << " " << configStatusName(entry.status)
+                              << " after " << entry.attempts << " attempt(s)\n";
+                }
+            }
+        }
+
+        // Saved only when something was sent, every start would wear the IMU's flash otherwise.
+        // Settings found already applied may only be in the IMU's RAM, so they are saved
+        // once when the cache has no record of them, the next start is then a cache hit.
+        report.save   = CONFIG_NOT_SENT;
+        bool saveNow  = sent || (m_configCache && !cached && count > 0 && confirmed);
+        configStep_t saveStep;
+        if (m_configSave && saveNow && status == DW_SUCCESS && imu->getSaveConfigStep(&saveStep))
+        {
+            configStepResult_t saveResult;
+            IMUConfigurator configurator(m_transport.get(), m_configVerify);
+            status      = configurator.run(&saveStep, 1, &saveResult);
+            report.save = saveResult.status;
+            if (report.save != CONFIG_VERIFIED && report.save != CONFIG_UNVERIFIED)
+            {
+                std::cerr << "startSensor: save configuration " << configStatusName(report.save) << " after "
+                          << saveResult.attempts << " attempt(s)\n";
+            }
+        }
+        report.configured_us = elapsedSinceStart();
+
+        // Only a configuration read back in full and confirmed saved survives a power
+        // cycle of the IMU, anything else must be sent again at the next start
+        if (m_configCache && !cached)
+        {
+            if (count > 0 && confirmed && report.save == CONFIG_VERIFIED)
+                m_configCache->store(m_busName, m_imuAddress, fingerprint);
+            else
+                m_configCache->erase(m_busName, m_imuAddress);
+        }
+
+        if (report.paramCount > 0)
+        {
+            std::cout << "startSensor: IMU 0x" << std::hex << static_cast<int>(m_imuAddress) << std::dec << " configured in "
+                      << report.configured_us << " us, " << verified << " of " << report.paramCount << " parameters "
+                      << (cached ? "cached" : "verified") << "\n";
+        }
+
+        std::lock_guard<std::mutex> guard(m_configLock);
+        m_configReport = report;
+        return status;
+    }
+
+    // Queues the messages of one pushData call
+    dwStatus pushMessages(const uint8_t* data, const size_t size, size_t* lenPushed)
+    {
+        //cout << "Pushing Data\r\n";
+        size_t offset = 0;
+        for (; offset + sizeof(dwCANMessage) <= size; offset += sizeof(dwCANMessage))
+        {
+            const dwCANMessage* message = reinterpret_cast<const dwCANMessage*>(data + offset);
+            if (!m_queueByRef)
+            {
+                if (m_copyBuffer.size() >= m_pool->size() && !makeRoom())
+                {
+                    if (m_overflowPolicy == OVERFLOW_DROP_NEWEST)
+                    {
+                        m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    m_rejected.fetch_add(1, std::memory_order_relaxed);
+                    *lenPushed = offset;
+                    return DW_BUFFER_FULL;
+                }
+                m_copyBuffer.push(*message);
+                continue;
+            }
+
+            // With zeroCopy=1 slots and transport storage are queued by reference,
+            // anything else (e.g. data replayed by a virtual sensor) only lives
+            // for this call
+            if (m_pool->owns(message))
+            {
+                m_pool->addRef(message);
+            }
+            else if (!m_transport || !m_transport->ownsMessage(message))
+            {
+                dwCANMessage* copy = getSlot(0);
+                if (copy == nullptr && m_overflowPolicy == OVERFLOW_DROP_NEWEST)
+                {
+                    m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                if (copy == nullptr)
+                {
+                    m_rejected.fetch_add(1, std::memory_order_relaxed);
+                    *lenPushed = offset;
+                    return DW_BUFFER_FULL;
+                }
+                memcpy(copy, data + offset, sizeof(dwCANMessage));
+                message = copy;
+            }
+
+            // Transport storage does not take slots, the queue is bounded separately
+            if (m_buffer.size() >= m_pool->size())
+            {
+                if (m_overflowPolicy == OVERFLOW_DROP_NEWEST)
+                {
+                    m_pool->release(message);
+                    m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                if (m_overflowPolicy == OVERFLOW_BLOCK || !dropOldest())
+                {
+                    m_pool->release(message);
+                    m_rejected.fetch_add(1, std::memory_order_relaxed);
+                    *lenPushed = offset;
+                    return DW_BUFFER_FULL;
+                }
+            }
+            m_buffer.push(message);
+        }
+        *lenPushed = offset;
+        return DW_SUCCESS;
+    }
+
+    // Decodes queued messages until a frame is complete
+    dwStatus parseNext(dwIMUFrame* frame, size_t* consumed)
+    {
+        const dwCANMessage* message = nullptr;
+        dwCANMessage copy;
+
+        if (consumed)
+            *consumed = 0;
+
+        // A confirmed change may have dropped a packet, e.g. packetType=
+        dwTime_t confirmed_us = m_reconfig.getConfirmedTimestamp();
+        if (m_assembleFrames && confirmed_us != m_relearnedAt_us)
+        {
+            m_assembler.relearn(confirmed_us);
+            m_relearnedAt_us = confirmed_us;
+        }
+
+        // Frame completed by a previous call
+        if (m_assembleFrames && m_assembler.next(frame))
+        {
+            return DW_SUCCESS;
+        }
+
+        while (takeQueued(&message, &copy, 1) != 0)
+        {
+            dwIMUFrame part                = {};
+            part.timestamp_us              = message->timestamp_us;
+            PluginStats::timestamp_t start = PluginStats::now();
+            if (!imu->parseDataPacket(*message, &part))
+            {
+                part.flags = 0;
+            }
+            m_stats.record(PLUGIN_STAGE_PARSE, start);
+            m_stats.countMessage(message->id, part.flags != 0);
+            releaseTaken(message);
+
+            if (consumed)
+                *consumed += sizeof(dwCANMessage);
+
+            // Not an IMU data packet
+            if (part.flags == 0)
+            {
+                return DW_FAILURE;
+            }
+
+            if (!m_assembleFrames)
+            {
+                *frame = part;
+                return DW_SUCCESS;
+            }
+
+            m_assembler.add(part, elapsedSinceStart());
+            if (m_assembler.next(frame))
+            {
+                return DW_SUCCESS;
+            }
+        }
+
+        // Queue drained, do not hold a partial epoch past frameTimeout=
+        if (m_assembleFrames)
+        {
+            m_assembler.flushExpired(elapsedSinceStart());
+            if (m_assembler.next(frame))
+            {
+                return DW_SUCCESS;
+            }
+        }
+
+        return DW_NOT_AVAILABLE;
+    }
+
+    // Drops the queued messages and their slot references
+    void clearQueue()
+    {
+        const dwCANMessage* message = nullptr;
+        dwCANMessage copy;
+        while (takeQueued(&message, &copy, 1) != 0)
+        {
+            releaseTaken(message);
+        }
+    }
+
+    // Removes up to maxCount of the oldest queued messages. Copied messages are
+    // moved to copies[] and messages[] points there, with zeroCopy=1 messages[]
+    // points to the queued slots. Either way hand each one to releaseTaken().
+    // With drop-oldest, pushData may remove from the consumer end too and both
+    // sides serialize.
+    size_t takeQueued(const dwCANMessage** messages, dwCANMessage* copies, size_t maxCount)
+    {
+        std::unique_lock<std::mutex> lock(m_queueLock, std::defer_lock);
+        if (m_overflowPolicy == OVERFLOW_DROP_OLDEST)
+            lock.lock();
+
+        if (!m_queueByRef)
+        {
+            const dwCANMessage* first;
+            size_t count = m_copyBuffer.frontBatch(&first, maxCount);
+            for (size_t i = 0; i < count; i++)
+            {
+                copies[i]   = first[i];
+                messages[i] = &copies[i];
+            }
+            m_copyBuffer.pop(count);
+            return count;
+        }
+
+        const dwCANMessage* const* first;
+        size_t count = m_buffer.frontBatch(&first, maxCount);
+        std::copy(first, first + count, messages);
+        m_buffer.pop(count);
+        return count;
+    }
+
+    void releaseTaken(const dwCANMessage* message)
+    {
+        if (m_queueByRef)
+            m_pool->release(message);
+    }
+
+    // Discards the oldest queued message, false if nothing is queued
+    bool dropOldest()
+    {
+        const dwCANMessage* message = nullptr;
+        dwCANMessage copy;
+        if (takeQueued(&message, &copy, 1) == 0)
+            return false;
+
+        releaseTaken(message);
+        m_droppedOldest.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Frees a place in the full copy queue under drop-oldest
+    bool makeRoom()
+    {
+        return m_overflowPolicy == OVERFLOW_DROP_OLDEST && dropOldest();
+    }
+
+    // Free message slot, applying the overflow policy when there is none.
+    // nullptr if the policy could not make one available.
+    dwCANMessage* getSlot(dwTime_t timeout_us)
+    {
+        dwCANMessage* slot = m_pool->get();
+        if (slot != nullptr)
+            return slot;
+
+        switch (m_overflowPolicy)
+        {
+        case OVERFLOW_DROP_OLDEST:
+            // Slots still held by the caller are not reclaimed, copied
+            // messages do not hold a slot
+            while (slot == nullptr && m_queueByRef && dropOldest())
+                slot = m_pool->get();
+            break;
+        case OVERFLOW_BLOCK:
+            if (timeout_us == 0)
+                break;
+            m_blocked.fetch_add(1, std::memory_order_relaxed);
+            slot = m_pool->wait(timeout_us);
+            if (slot == nullptr)
+                m_blockTimeouts.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case OVERFLOW_DROP_NEWEST:
+            break;
+        }
+        return slot;
+    }
+
+    // Transport reads and the validity filter, timed with ENABLE_PLUGIN_STATS
+    dwStatus readTimed(dwCANMessage* message, dwTime_t timeout_us)
+    {
+        PluginStats::timestamp_t start = PluginStats::now();
+        dwStatus status                = m_transport->readMessage(message, timeout_us);
+        m_stats.record(PLUGIN_STAGE_CAN_READ, start);
+        return status;
+    }
+
+    dwStatus readTimed(const dwCANMessage** message, dwTime_t timeout_us)
+    {
+        PluginStats::timestamp_t start = PluginStats::now();
+        dwStatus status                = m_transport->readMessageRef(message, timeout_us);
+        m_stats.record(PLUGIN_STAGE_CAN_READ, start);
+        return status;
+    }
+
+    bool isValidTimed(uint32_t id)
+    {
+        PluginStats::timestamp_t start = PluginStats::now();
+        bool valid                     = imu->isValidMessage(id);
+        m_stats.record(PLUGIN_STAGE_FILTER, start);
+        return valid;
+    }
+
+    // Time left until deadline, 0 once it has passed
+    static dwTime_t remainingUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<dwTime_t>(left) : 0;
+    }
+
+    // Reads the next IMU message from the transport, the reader thread or the replay mapping.
+    // Waits at most timeout_us in total, however much foreign traffic is skipped.
+    dwStatus readValidMessage(const uint8_t** data, size_t* size, dwTime_t timeout_us,
+                              std::chrono::steady_clock::time_point deadline)
+    {
+        if (m_zeroCopyRead && !m_readerRunning)
+        {
+            // Hand out the transport's own storage, no slot needed
+            const dwCANMessage* message = nullptr;
+            dwStatus status;
+            dwTime_t remaining = timeout_us;
+            while ((status = readTimed(&message, remaining)) == DW_SUCCESS)
+            {
+                if (isValidTimed(message->id))
+                {
+                    *data = reinterpret_cast<const uint8_t*>(message);
+                    *size = sizeof(dwCANMessage);
+                    return DW_SUCCESS;
+                }
+                if (timeout_us > 0 && (remaining = remainingUntil(deadline)) == 0)
+                    return DW_TIME_OUT;
+            }
+            return status;
+        }
+
+        dwCANMessage* result = m_pool->get();    // Get an empty message slot from plugin's empty message pool
+        if (result == nullptr)
+        {
+            if (m_overflowPolicy != OVERFLOW_BLOCK)
+                return readOverflow(data, size, timeout_us, deadline);
+
+            result = getSlot(timeout_us);
+            if (result == nullptr)
+                return timeout_us > 0 ? DW_TIME_OUT : DW_BUFFER_FULL;
+
+            // Part of the timeout went into waiting for the slot
+            timeout_us = timeout_us > 0 ? remainingUntil(deadline) : 0;
+        }
+
+        dwStatus status = readNext(result, timeout_us, deadline);
+        if (status != DW_SUCCESS)
+        {
+            // Nothing valid read, the slot would otherwise hold a stale message
+            m_pool->release(result);
+            return status;
+        }
+
+        *data = reinterpret_cast<uint8_t*>(result);
+        *size = sizeof(dwCANMessage);
+        return DW_SUCCESS;
+    }
+
+    // Reads the next IMU message from the reader thread or the transport into message
+    dwStatus readNext(dwCANMessage* message, dwTime_t timeout_us, std::chrono::steady_clock::time_point deadline)
+    {
+        if (m_readerRunning)
+        {
+            // Reader thread already filtered the messages, only wait for one to arrive
+            if (!popReceived(message, timeout_us))
+                return m_readerEnded ? DW_END_OF_STREAM : DW_TIME_OUT;
+            return DW_SUCCESS;
+        }
+
+        // Runtime configuration goes out on the reading thread
+        m_reconfig.service(m_transport.get());
+
+        // Read sensor raw data to provided message slot
+        dwStatus status;
+        dwTime_t remaining = timeout_us;
+        while ((status = readTimed(message, remaining)) == DW_SUCCESS)
+        {
+          if(isValidTimed(message->id) && !m_reconfig.filter(*message))
+            return DW_SUCCESS;
+
+          // Foreign traffic and readback answers do not extend the wait beyond the caller's timeout
+          if(timeout_us > 0 && (remaining = remainingUntil(deadline)) == 0)
+            return DW_TIME_OUT;
+        }
+        return status;
+    }
+
+    // Reads the next IMU message while no slot is free. drop-oldest makes room
+    // for it by discarding the oldest queued message, drop-newest discards it.
+    dwStatus readOverflow(const uint8_t** data, size_t* size, dwTime_t timeout_us,
+                          std::chrono::steady_clock::time_point deadline)
+    {
+        dwStatus status = readNext(&m_overflowMessage, timeout_us, deadline);
+        if (status != DW_SUCCESS)
+            return status;
+
+        dwCANMessage* result = (m_overflowPolicy == OVERFLOW_DROP_OLDEST) ? getSlot(0) : nullptr;
+        if (result == nullptr)
+        {
+            m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+            return DW_BUFFER_FULL;
+        }
+
+        *result = m_overflowMessage;
+        *data   = reinterpret_cast<uint8_t*>(result);
+        *size   = sizeof(dwCANMessage);
+        return DW_SUCCESS;
+    }
+
+    void startReader()
+    {
+        if (m_readerRunning)
+            return;
+
+        m_readerRunning = true;
+        m_readerEnded   = false;
+        m_reader        = std::thread(&AceinnaIMUSensor::readerLoop, this);
+    }
+
+    void stopReader()
+    {
+        if (!m_readerRunning)
+            return;
+
+        m_readerRunning = false;
+        if (m_reader.joinable())
+            m_reader.join();
+    }
+
+    // Reader thread, moves valid IMU messages from the CAN sensor to m_rxBuffer
+    void readerLoop()
+    {
+        dwCANMessage message;
+        uint64_t failures = 0;
+        while (m_readerRunning)
+        {
+            m_reconfig.service(m_transport.get());
+
+            dwStatus status = readTimed(&message, READER_POLL_TIMEOUT_US);
+            if (status == DW_END_OF_STREAM)
+            {
+                m_readerEnded = true;
+                break;
+            }
+            if (status != DW_SUCCESS && status != DW_TIME_OUT)
+            {
+                // E.g. bus-off or the interface went down, a read that fails at
+                // once must not spin the thread until it recovers
+                if (failures++ == 0)
+                    std::cerr << "readerThread: read failed (" << status << "), retrying every "
+                              << READER_POLL_TIMEOUT_US << " us\n";
+                std::this_thread::sleep_for(std::chrono::microseconds(READER_POLL_TIMEOUT_US));
+                continue;
+            }
+            if (failures > 0)
+            {
+                std::cerr << "readerThread: read recovered after " << failures << " failures\n";
+                failures = 0;
+            }
+            if (status != DW_SUCCESS || !isValidTimed(message.id) || m_reconfig.filter(message))
+                continue;
+
+            if (!m_rxBuffer.push(message))
+            {
+                m_readerDropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            // Pairs with the fence in popReceived(), one of the two sides sees the other
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_readerWaiting)
+            {
+                std::lock_guard<std::mutex> lock(m_readerLock);
+                m_readerSignal.notify_one();
+            }
+        }
+    }
+
+    // Takes the oldest message of the reader thread, waits up to timeout_us for one
+    bool popReceived(dwCANMessage* message, dwTime_t timeout_us)
+    {
+        const dwCANMessage* received = m_rxBuffer.front();
+        if (received == nullptr && timeout_us > 0)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+            std::unique_lock<std::mutex> lock(m_readerLock);
+            m_readerWaiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while ((received = m_rxBuffer.front()) == nullptr && m_readerRunning && !m_readerEnded)
+            {
+                if (m_readerSignal.wait_until(lock, deadline) == std::cv_status::timeout)
+                {
+                    received = m_rxBuffer.front();
+                    break;
+                }
+            }
+            m_readerWaiting = false;
+        }
+
+        if (received == nullptr)
+            return false;
+
+        *message = *received;
+        m_rxBuffer.pop();
+        return true;
+    }
+
+    // Opens the CAN transport selected by can-proto=
+    dwStatus openTransport(const std::string& protocolString, const std::string& paramsString, std::unique_ptr<CANTransport>* transport)
+    {
+        std::string value;
+        if (protocolString == "can.native")
+        {
+            // Raw SocketCAN, bypasses the SAL CAN sensor
+            std::string device;
+            size_t batchSize = SOCKETCAN_DEFAULT_BATCH;
+            if (!getPluginParameter(paramsString, "device=", &device))
+            {
+                std::cerr << "createSensor: can.native requires device=\n";
+                return DW_FAILURE;
+            }
+            if (getPluginParameter(paramsString, "recvBatch=", &value))
+            {
+                batchSize = strtoul(value.c_str(), nullptr, 10);
+            }
+
+            std::unique_ptr<SocketCANTransport> socketCAN(new SocketCANTransport(batchSize));
+            if (socketCAN->open(device) != DW_SUCCESS)
+            {
+                std::cerr << "createSensor: Cannot open SocketCAN device " << device << std::endl;
+                return DW_FAILURE;
+            }
+
+            canTimestampSource_t timestampSource = TIMESTAMP_KERNEL;
+            if (getPluginParameter(paramsString, "timestampSource=", &value))
+            {
+                if (value == "host")
+                    timestampSource = TIMESTAMP_HOST;
+                else if (value == "hardware")
+                    timestampSource = TIMESTAMP_HARDWARE;
+                else if (value != "kernel")
+                {
+                    std::cerr << "createSensor: timestampSource must be host, kernel or hardware\n";
+                    return DW_FAILURE;
+                }
+            }
+            if (timestampSource == TIMESTAMP_HARDWARE && socketCAN->setTimestampSource(timestampSource) != DW_SUCCESS)
+            {
+                std::cerr << "createSensor: Hardware timestamps not available, using kernel timestamps\n";
+                timestampSource = TIMESTAMP_KERNEL;
+            }
+            if (timestampSource != TIMESTAMP_HARDWARE && socketCAN->setTimestampSource(timestampSource) != DW_SUCCESS)
+            {
+                std::cerr << "createSensor: Timestamp source not available, using host time\n";
+                socketCAN->setTimestampSource(TIMESTAMP_HOST);
+            }
+            transport->reset(socketCAN.release());
+        }
+        else if (protocolString == "can.replay")
+        {
+            // Memory mapped capture file, messages are handed out without copying
+            std::string file;
+            bool realtime = true;
+            if (!getPluginParameter(paramsString, "file=", &file))
+            {
+                std::cerr << "createSensor: can.replay requires file=\n";
+                return DW_FAILURE;
+            }
+            if (getPluginParameter(paramsString, "replayMode=", &value))
+            {
+                if (value != "realtime" && value != "max")
+                {
+                    std::cerr << "createSensor: replayMode must be realtime or max\n";
+                    return DW_FAILURE;
+                }
+                realtime = (value == "realtime");
+            }
+
+            std::unique_ptr<ReplayCANTransport> replay(new ReplayCANTransport(realtime));
+            dwStatus status = replay->open(file);
+            if (status != DW_SUCCESS)
+            {
+                return status;
+            }
+            transport->reset(replay.release());
+        }
+        else
+        {
+            // create CAN bus interface
+            dwSensorHandle_t canSensor = nullptr;
+            dwSensorParams parameters{};
+            parameters.parameters = paramsString.c_str();
+            parameters.protocol   = protocolString.c_str();
+
+            if (dwSAL_createSensor(&canSensor, parameters, m_sal) != DW_SUCCESS)
+            {
+                std::cerr << "createSensor: Cannot create sensor "
+                          << parameters.protocol << " with " << parameters.parameters << std::endl;
+
+                return DW_FAILURE;
+            }
+            transport->reset(new SALCANTransport(canSensor));
+        }
+
+        return DW_SUCCESS;
+    }
+
+    // Decimal or 0x prefixed hex J1939 address
+    static bool parseAddress(const std::string& value, uint8_t* address)
+    {
+        char* end           = nullptr;
+        unsigned long parsed = strtoul(value.c_str(), &end, 0);
+        if (value.empty() || *end != '\0' || parsed > MAX_J1939_ADDRESS)
+            return false;
+        *address = static_cast<uint8_t>(parsed);
+        return true;
+    }
+
+    // Looks up "key=value" in the comma separated parameter string. The key
+    // must start the string or follow a comma so "rate=" does not match "xrate=".
+    static bool getPluginParameter(const std::string& params, const std::string& key, std::string* value)
+    {
+        size_t pos = 0;
+        while ((pos = params.find(key, pos)) != std::string::npos)
+        {
+            if (pos == 0 || params[pos - 1] == ',')
+            {
+                size_t end = params.find_first_of(",", pos);
+                *value     = params.substr(pos + key.length(), end == std::string::npos ? std::string::npos : end - pos - key.length());
+                return true;
+            }
+            pos += key.length();
+        }
+        return false;
+    }
+
     dwContextHandle_t m_ctx      = nullptr;
     dwSALHandle_t m_sal          = nullptr;
     dwSensorHandle_t m_canSensor = nullptr;
     bool m_virtualSensorFlag;
-
-    dw::plugin::common::ByteQueue m_buffer;
-    dw::plugins::common::BufferPool<dwCANMessage> m_slot;
-
-    IMU                   *imu;             // Pointer to IMU abstract class
+    std::unique_ptr<CANTransport> m_transport;   // CAN source selected by can-proto=
+    bool m_zeroCopyRead;                          // readRawData returns transport storage, see readMessageRef()
+    std::unique_ptr<CANRecorder> m_recorder;      // Set with record=
+
+    bool m_queueByRef;                            // zeroCopy=, pushData queues slots instead of copies
+    SPSCRing<dwCANMessage, MAX_BUFFER_POOL_SIZE> m_copyBuffer;      // Pushed messages waiting for parseData
+    SPSCRing<const dwCANMessage*, MAX_BUFFER_POOL_SIZE> m_buffer;   // Same with zeroCopy=1, not copied
+    std::unique_ptr<MessagePool> m_pool;          // Slots handed out by readRawData, and queued by pushData with zeroCopy=1, poolSize=
+    overflowPolicy_t m_overflowPolicy;            // Set with overflow=
+    dwCANMessage m_overflowMessage;               // Read while no slot is free, see readOverflow()
+    std::mutex m_queueLock;                       // Serializes removals from the queue under drop-oldest
+    std::atomic<uint64_t> m_blocked;
+    std::atomic<uint64_t> m_blockTimeouts;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_droppedOldest;
+    std::atomic<uint64_t> m_droppedNewest;
+    std::atomic<uint64_t> m_readerDropped;
+    uint8_t m_imuAddress;                         // imuAddress=, identifies the sensor to the exported statistics
+    LatencyHistogram m_readLatency;               // Time spent in readRawData
+    PluginStats m_stats;                          // Per stage timing, empty without ENABLE_PLUGIN_STATS
+
+    std::unique_ptr<IMU>  imu;              // Decoder of this sensor, not shared between sensors
     dwCANMessage          *configMessages;  // Pointer to IMU configuration messages
     uint8_t               configCount;     // Number of configuration messages from the IMU
+    bool                  m_configVerify;   // Read the configuration back at start, configVerify=
+    bool                  m_configDiff;     // Send only the settings the IMU does not hold, configDiff=
+    bool                  m_configSave;     // Save a changed configuration on the IMU, configSave=
+    std::unique_ptr<ConfigCache> m_configCache;   // Configurations confirmed at earlier starts, configCache=
+    std::string           m_busName;        // can-proto= and device= (or file=)
+    mutable std::mutex    m_configLock;     // Guards m_configReport
+    configReport_t        m_configReport;   // Outcome of the configuration at the last start
+    std::chrono::steady_clock::time_point m_startTime;
+    std::atomic<dwTime_t> m_streaming_us;   // Start to first frame, 0 until then
+    std::atomic<bool>     m_started;        // Between startSensor() and stopSensor()
+    std::mutex            m_reconfigLock;   // Serializes reconfigure() callers
+    RuntimeConfigurator   m_reconfig;       // Changes while streaming, sent by the reading thread
+
+    bool                  m_assembleFrames; // Emit one merged frame per sample epoch
+    IMUFrameAssembler     m_assembler;
+    dwTime_t              m_relearnedAt_us; // Confirmed change the assembler relearned after
+
+    bool                  m_asyncRead;      // Read the CAN sensor from m_reader instead of readRawData
+    std::thread           m_reader;
+    std::atomic<bool>     m_readerRunning;
+    std::atomic<bool>     m_readerWaiting;  // readRawData is blocked on m_readerSignal
+    std::atomic<bool>     m_readerEnded;    // CAN sensor reported end of stream
+    std::mutex            m_readerLock;
+    std::condition_variable m_readerSignal;
+    SPSCRing<dwCANMessage, READER_QUEUE_SIZE> m_rxBuffer;   // Filtered messages from the reader thread
 
 };
 } // namespace imu
 } // namespace plugins
 } // namespace dw
 
-std::vector<std::unique_ptr<dw::plugins::imu::AceinnaIMUSensor>> dw::plugins::imu::AceinnaIMUSensor::g_sensorContext;
+HandleRegistry<dw::plugins::imu::AceinnaIMUSensor, dw::plugins::imu::MAX_SENSOR_HANDLES> dw::plugins::imu::AceinnaIMUSensor::g_sensorRegistry;
 
 //#######################################################################################
-static bool checkValid(dw::plugins::imu::AceinnaIMUSensor* sensor)
+// Pins the sensor for the duration of the call, empty if the handle was released
+static HandleRegistry<dw::plugins::imu::AceinnaIMUSensor, dw::plugins::imu::MAX_SENSOR_HANDLES>::Ref acquireSensor(dwSensorPluginSensorHandle_t sensor)
 {
-    for (auto& i : dw::plugins::imu::AceinnaIMUSensor::g_sensorContext)
-    {
-        if (i.get() == sensor)
-            return true;
-    }
-    return false;
+    return dw::plugins::imu::AceinnaIMUSensor::g_sensorRegistry.acquire(sensor);
+}
+
+//#######################################################################################
+// Pins the only sensor decoding imuAddress. Empty with *status DW_INVALID_ARGUMENT
+// if there is none, DW_FAILURE if sensors on several buses decode that address.
+static HandleRegistry<dw::plugins::imu::AceinnaIMUSensor, dw::plugins::imu::MAX_SENSOR_HANDLES>::Ref findSensor(uint8_t imuAddress,
+                                                                                                              dwStatus* status)
+{
+    bool ambiguous = false;
+    auto sensorContext = dw::plugins::imu::AceinnaIMUSensor::g_sensorRegistry.findUnique(
+        [imuAddress](const dw::plugins::imu::AceinnaIMUSensor& sensor) { return sensor.getIMUAddress() == imuAddress; },
+        &ambiguous);
+    *status = ambiguous ? DW_FAILURE : DW_INVALID_ARGUMENT;
+    return sensorContext;
 }
 
 // exported functions
@@ -304,8 +1368,12 @@ dwStatus _dwSensorPlugin_createHandle(dwSensorPluginSensorHandle_t* sensor, dwSe
     size_t slotSize    = dw::plugins::imu::SAMPLE_BUFFER_POOL_SIZE; // Size of memory pool to read raw data from the sensor
     auto sensorContext = new dw::plugins::imu::AceinnaIMUSensor(ctx, DW_NULL_HANDLE, slotSize);
 
-    dw::plugins::imu::AceinnaIMUSensor::g_sensorContext.push_back(std::unique_ptr<dw::plugins::imu::AceinnaIMUSensor>(sensorContext));
-    *sensor = dw::plugins::imu::AceinnaIMUSensor::g_sensorContext.back().get();
+    *sensor = dw::plugins::imu::AceinnaIMUSensor::g_sensorRegistry.add(sensorContext);
+    if (*sensor == nullptr)
+    {
+        delete sensorContext;
+        return DW_CANNOT_CREATE_OBJECT;
+    }
 
     // Populate sensor properties
     properties->packetSize = sizeof(dwCANMessage);
@@ -317,8 +1385,8 @@ dwStatus _dwSensorPlugin_createHandle(dwSensorPluginSensorHandle_t* sensor, dwSe
 dwStatus _dwSensorPlugin_createSensor(const char* params, dwSALHandle_t sal, dwSensorPluginSensorHandle_t sensor)
 {
 
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -329,8 +1397,8 @@ dwStatus _dwSensorPlugin_createSensor(const char* params, dwSALHandle_t sal, dwS
 //#######################################################################################
 dwStatus _dwSensorPlugin_start(dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -341,33 +1409,24 @@ dwStatus _dwSensorPlugin_start(dwSensorPluginSensorHandle_t sensor)
 //#######################################################################################
 dwStatus _dwSensorPlugin_release(dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    // Invalidates the handle first and waits for calls still using it
+    std::unique_ptr<dw::plugins::imu::AceinnaIMUSensor> sensorContext(
+        dw::plugins::imu::AceinnaIMUSensor::g_sensorRegistry.remove(sensor));
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
 
-    for (auto iter =
-                    dw::plugins::imu::AceinnaIMUSensor::g_sensorContext.begin();
-                    iter != dw::plugins::imu::AceinnaIMUSensor::g_sensorContext.end();
-                    ++iter)
-    {
-        if ((*iter).get() == sensor)
-        {
-            sensorContext->stopSensor();
-            sensorContext->releaseSensor();
-            dw::plugins::imu::AceinnaIMUSensor::g_sensorContext.erase(iter);
-            return DW_SUCCESS;
-        }
-    }
-    return DW_FAILURE;
+    sensorContext->stopSensor();
+    sensorContext->releaseSensor();
+    return DW_SUCCESS;
 }
 
 //#######################################################################################
 dwStatus _dwSensorPlugin_stop(dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -378,8 +1437,8 @@ dwStatus _dwSensorPlugin_stop(dwSensorPluginSensorHandle_t sensor)
 //#######################################################################################
 dwStatus _dwSensorPlugin_reset(dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -391,8 +1450,8 @@ dwStatus _dwSensorPlugin_reset(dwSensorPluginSensorHandle_t sensor)
 dwStatus _dwSensorPlugin_readRawData(const uint8_t** data, size_t* size, dwTime_t* /*timestamp*/,
                                      dwTime_t timeout_us, dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -403,8 +1462,8 @@ dwStatus _dwSensorPlugin_readRawData(const uint8_t** data, size_t* size, dwTime_
 //#######################################################################################
 dwStatus _dwSensorPlugin_returnRawData(const uint8_t* data, dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -415,8 +1474,8 @@ dwStatus _dwSensorPlugin_returnRawData(const uint8_t* data, dwSensorPluginSensor
 //#######################################################################################
 dwStatus _dwSensorPlugin_pushData(size_t* lenPushed, const uint8_t* data, const size_t size, dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -427,8 +1486,8 @@ dwStatus _dwSensorPlugin_pushData(size_t* lenPushed, const uint8_t* data, const
 //#######################################################################################
 dwStatus _dwSensorIMUPlugin_parseDataBuffer(dwIMUFrame* frame, size_t* consumed, dwSensorPluginSensorHandle_t sensor)
 {
-    auto sensorContext = reinterpret_cast<dw::plugins::imu::AceinnaIMUSensor*>(sensor);
-    if (!checkValid(sensorContext))
+    auto sensorContext = acquireSensor(sensor);
+    if (!sensorContext)
     {
         return DW_INVALID_HANDLE;
     }
@@ -436,6 +1495,92 @@ dwStatus _dwSensorIMUPlugin_parseDataBuffer(dwIMUFrame* frame, size_t* consumed,
     return sensorContext->parseData(frame, consumed);
 }
 
+//#######################################################################################
+dwStatus dwSensorIMUPlugin_getReadLatency(uint8_t imuAddress, latencyHistogram_t* histogram)
+{
+    if (histogram == nullptr)
+        return DW_INVALID_ARGUMENT;
+
+    dwStatus lookup;
+    auto sensorContext = findSensor(imuAddress, &lookup);
+    if (!sensorContext)
+    {
+        return lookup;
+    }
+
+    sensorContext->getReadLatency(histogram);
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensorIMUPlugin_getConfigReport(uint8_t imuAddress, configReport_t* report)
+{
+    if (report == nullptr)
+        return DW_INVALID_ARGUMENT;
+
+    dwStatus lookup;
+    auto sensorContext = findSensor(imuAddress, &lookup);
+    if (!sensorContext)
+    {
+        return lookup;
+    }
+
+    sensorContext->getConfigReport(report);
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensorIMUPlugin_reconfigure(uint8_t imuAddress, const char* params)
+{
+    if (params == nullptr)
+        return DW_INVALID_ARGUMENT;
+
+    dwStatus lookup;
+    auto sensorContext = findSensor(imuAddress, &lookup);
+    if (!sensorContext)
+    {
+        return lookup;
+    }
+
+    return sensorContext->reconfigure(params);
+}
+
+//#######################################################################################
+dwStatus dwSensorIMUPlugin_getReconfigStatus(uint8_t imuAddress, reconfigStatus_t* status)
+{
+    if (status == nullptr)
+        return DW_INVALID_ARGUMENT;
+
+    dwStatus lookup;
+    auto sensorContext = findSensor(imuAddress, &lookup);
+    if (!sensorContext)
+    {
+        return lookup;
+    }
+
+    sensorContext->getReconfigStatus(status);
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensorIMUPlugin_getStats(uint8_t imuAddress, pluginStats_t* stats)
+{
+    if (stats == nullptr)
+        return DW_INVALID_ARGUMENT;
+    if (!PluginStats::enabled)
+        return DW_NOT_SUPPORTED;
+
+    dwStatus lookup;
+    auto sensorContext = findSensor(imuAddress, &lookup);
+    if (!sensorContext)
+    {
+        return lookup;
+    }
+
+    sensorContext->getStats(stats);
+    return DW_SUCCESS;
+}
+
 //#######################################################################################
 dwStatus dwSensorIMUPlugin_getFunctionTable(dwSensorIMUPluginFunctionTable* functions)
 {
@@ -12,11 +12,11 @@ limitations under the License.
 *******************************************************************************/
 
 #include <openimu300_plugin.h>
+#include <packet_decoder.h>
+#include <param_tokenizer.h>
+#include <cstring>
 // TODO (06/10/2020):
-// 1. Support for hex and decimal both for parameter values
 // 2. Set Bank of PS number configuration not supported
-// 4. findExtendedDataPacket() should be improved to O(1) from O(n).
-//      There is a significant overhead as it gets called at 200hz
 // 5. Units for each IMUFrame needs to be verified atleast once
 // 6. Add const keyword as much as possible
 // 7. Restructoring (Open to extension close to modification)
@@ -24,52 +24,90 @@ limitations under the License.
 
 //#define STD_ID
 
-#define VALID_PACKET_RATES    9
-#define VALID_PACKET_TYPES    16
-#define VALID_CUTOFF_FREQS    7
-#define VALID_ORIENTATIONS    24
 #define BANK_OF_PS_VAL_LOWER  0x40
 #define BANK_OF_PS_VAL_UPPER  0x7F
 
 
 // Note1: Order of this struct initializer must match with enum imuMessages
-static pgn IMU300pgnList[] =  {
-                     {.type = REQUEST_PACKET,         .PF = 234, .PS = 255}   //GET_PACKET
-                    ,{.type = REQUEST_PACKET,         .PF = 253, .PS = 197}   //ECU_ID
-                    ,{.type = REQUEST_PACKET,         .PF = 254, .PS = 218}   //SOFTWARE_VER
-                    ,{.type = CONFIGURATION_PACKET,   .PF = 255, .PS = 80}    //RESET_ALGORITHM
-                    ,{.type = CONFIGURATION_PACKET,   .PF = 255, .PS = 81}    //SAVE_CONFIGURAITON
-                    ,{.type = REQ_CONFIG_PACKET,      .PF = 255, .PS = 85}    //PACKET_RATE
-                    ,{.type = REQ_CONFIG_PACKET,      .PF = 255, .PS = 86}    //PACKET_TYPE
-                    ,{.type = REQ_CONFIG_PACKET,      .PF = 255, .PS = 87}    //FILTER_FREQ
-                    ,{.type = REQ_CONFIG_PACKET,      .PF = 255, .PS = 88}    //ORIENTATION
-                    ,{.type = CONFIGURATION_PACKET,   .PF = 255, .PS = 94}    //MAG_ALIGNMENT
-                    ,{.type = REQ_CONFIG_PACKET,      .PF = 255, .PS = 95}    //LEVER_ARM
-                    ,{.type = CONFIGURATION_PACKET,   .PF = 255, .PS = 240}   //BOPS_BANK0
-                    ,{.type = CONFIGURATION_PACKET,   .PF = 255, .PS = 241}   //BOPS_BANK1
-                    ,{.type = DATA_PACKET,            .PF = 240, .PS = 41}    //SSI1_PT
-                    ,{.type = DATA_PACKET,            .PF = 240, .PS = 42}    //ANGULAR_RATE_PT
-                    ,{.type = DATA_PACKET,            .PF = 240, .PS = 45}    //ACCEL_PT
-                    ,{.type = DATA_PACKET,            .PF = 255, .PS = 106}   //MAGNETOMETER_PT
-                    //,{.type = DATA_PACKET,            .PF = 238, .PS = 255}   //ADDRESS_CLAIM_PT
+// Note2: Default PGNs, each OpenIMU300 works on its own copy (pgnList) since
+// Bank of PS parameters remap them
+static const pgn IMU300pgnList[] =  {
+                     {REQUEST_PACKET,         234, 255}   //GET_PACKET
+                    ,{REQUEST_PACKET,         253, 197}   //ECU_ID
+                    ,{REQUEST_PACKET,         254, 218}   //SOFTWARE_VER
+                    ,{CONFIGURATION_PACKET,   255, 80}    //RESET_ALGORITHM
+                    ,{CONFIGURATION_PACKET,   255, 81}    //SAVE_CONFIGURAITON
+                    ,{REQ_CONFIG_PACKET,      255, 85}    //PACKET_RATE
+                    ,{REQ_CONFIG_PACKET,      255, 86}    //PACKET_TYPE
+                    ,{REQ_CONFIG_PACKET,      255, 87}    //FILTER_FREQ
+                    ,{REQ_CONFIG_PACKET,      255, 88}    //ORIENTATION
+                    ,{CONFIGURATION_PACKET,   255, 94}    //MAG_ALIGNMENT
+                    ,{REQ_CONFIG_PACKET,      255, 95}    //LEVER_ARM
+                    ,{CONFIGURATION_PACKET,   255, 240}   //BOPS_BANK0
+                    ,{CONFIGURATION_PACKET,   255, 241}   //BOPS_BANK1
+                    ,{DATA_PACKET,            240, 41}    //SSI1_PT
+                    ,{DATA_PACKET,            240, 42}    //ANGULAR_RATE_PT
+                    ,{DATA_PACKET,            240, 45}    //ACCEL_PT
+                    ,{DATA_PACKET,            255, 106}   //MAGNETOMETER_PT
+                    //,{DATA_PACKET,            238, 255}   //ADDRESS_CLAIM_PT
                    };
+static_assert(sizeof(IMU300pgnList)/sizeof(IMU300pgnList[0]) == MAX_PGN, "IMU300pgnList must match imuMessages");
+
+#define DEG_TO_RAD            0.017453292519943295
+
+// Payload layout of each data PGN, see packet_decoder.h. A new data PGN only
+// needs its entry here (and in imuMessages/IMU300pgnList).
+static constexpr packetLayout dataPackets[] = {
+  // Degree, pitch in bits 0-23, roll in bits 24-47
+  {SSI1_PT,         DW_IMU_ROLL | DW_IMU_PITCH,                                             7, 3, {
+    {3, 3, 1.0 / 32768, -250.0, &dwIMUFrame::orientation, 0},
+    {0, 3, 1.0 / 32768, -250.0, &dwIMUFrame::orientation, 1},
+    {0, 0, 0.0,          0.0,   &dwIMUFrame::orientation, 2}}},
+  // Rad/s
+  {ANGULAR_RATE_PT, DW_IMU_ROLL_RATE | DW_IMU_PITCH_RATE | DW_IMU_YAW_RATE,                 7, 3, {
+    {0, 2, DEG_TO_RAD / 128, -250.0 * DEG_TO_RAD, &dwIMUFrame::turnrate, 0},
+    {2, 2, DEG_TO_RAD / 128, -250.0 * DEG_TO_RAD, &dwIMUFrame::turnrate, 1},
+    {4, 2, DEG_TO_RAD / 128, -250.0 * DEG_TO_RAD, &dwIMUFrame::turnrate, 2}}},
+  // m/s^2
+  {ACCEL_PT,        DW_IMU_ACCELERATION_X | DW_IMU_ACCELERATION_Y | DW_IMU_ACCELERATION_Z,  PACKET_NO_LATENCY, 3, {
+    {0, 2, 0.01, -320.0, &dwIMUFrame::acceleration, 0},
+    {2, 2, 0.01, -320.0, &dwIMUFrame::acceleration, 1},
+    {4, 2, 0.01, -320.0, &dwIMUFrame::acceleration, 2}}},
+  // uTesla, 0.00025 Gauss/bit - 8 Gauss
+  {MAGNETOMETER_PT, DW_IMU_MAGNETOMETER_X | DW_IMU_MAGNETOMETER_Y | DW_IMU_MAGNETOMETER_Z,  PACKET_NO_LATENCY, 3, {
+    {0, 2, 0.025, -800.0, &dwIMUFrame::magnetometer, 0},
+    {2, 2, 0.025, -800.0, &dwIMUFrame::magnetometer, 1},
+    {4, 2, 0.025, -800.0, &dwIMUFrame::magnetometer, 2}}},
+};
+static constexpr size_t dataPacketCount = sizeof(dataPackets) / sizeof(dataPackets[0]);
+
+// Indexed by imuMessages, MAX_PGN (not an IMU message) included
+typedef packetDecoderTable<MAX_PGN + 1, dataPacketCount, dataPackets> dataPacketDecoders;
 
 
-const string paramNames[] = { "resetAlgoPS=",       "setPacketRatePS=",   "setPacketTypePS=",
-                              "setFilterCutoffPS=", "setOrientationPS=",  "packetRate=",
-                              "packetType=",        "orientation=",       "rateLPF=",
-                              "accelLPF=",          "resetAlgo=",
-                                  };
+#define PARAM_KEY(name)       {name, sizeof(name) - 1}
 
-const uint8_t validPacketRates[VALID_PACKET_RATES] = {0,1,2,4,5,10,20,25,50};
-const uint8_t validPacketTypes[VALID_PACKET_TYPES] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
-const uint8_t validCutoffFreqs[VALID_CUTOFF_FREQS] = {0,2,5,10,25,40,50};
-const uint16_t validOrientations[VALID_ORIENTATIONS] = {0x0000, 0x0009, 0x0023, 0x002A,
-                                                      0x0041, 0x0048, 0x0062, 0x006B,
-                                                      0x0085, 0x008C, 0x0092, 0x009B,
-                                                      0x00C4, 0x00CD, 0x00D3, 0x00DA,
-                                                      0x0111, 0x0118, 0x0124, 0x012D,
-                                                      0x0150, 0x0159, 0x0165, 0x016C};
+// Keys of the parameter string, without '='. Order must match IMUPARAM_t
+// followed by IMUOPTION_t.
+static const paramView paramKeys[] = {
+  PARAM_KEY("resetAlgoPS"),       PARAM_KEY("setPacketRatePS"),   PARAM_KEY("setPacketTypePS"),
+  PARAM_KEY("setFilterCutoffPS"), PARAM_KEY("setOrientationPS"),  PARAM_KEY("packetRate"),
+  PARAM_KEY("packetType"),        PARAM_KEY("orientation"),       PARAM_KEY("rateLPF"),
+  PARAM_KEY("accelLPF"),          PARAM_KEY("resetAlgo"),
+  PARAM_KEY("latencyCompensation"), PARAM_KEY("canBitrate"),
+};
+static_assert(sizeof(paramKeys)/sizeof(paramKeys[0]) == OPTION_MAX_KEYS, "paramKeys must match IMUPARAM_t and IMUOPTION_t");
+
+static constexpr ValueSet validPacketRates(0, 1, 2, 4, 5, 10, 20, 25, 50);
+static constexpr ValueSet validPacketTypes(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+static constexpr ValueSet validCutoffFreqs(0, 2, 5, 10, 25, 40, 50);
+static constexpr ValueSet validOrientations(0x0000, 0x0009, 0x0023, 0x002A,
+                                            0x0041, 0x0048, 0x0062, 0x006B,
+                                            0x0085, 0x008C, 0x0092, 0x009B,
+                                            0x00C4, 0x00CD, 0x00D3, 0x00DA,
+                                            0x0111, 0x0118, 0x0124, 0x012D,
+                                            0x0150, 0x0159, 0x0165, 0x016C);
+static constexpr ValueSet validFlags(0, 1);
 
 const imuParameters_t defaultParams = {
           .packetRate   = 1,
@@ -83,24 +121,9 @@ const imuParameters_t defaultParams = {
 //----------------------------------------------------------------------------//
 
 // Bank of PS number has to be within [0x40,0x80)
-bool OpenIMU300::isValidBankOfPSPacket(uint16_t value)
-{
-  if(!(BANK_OF_PS_VAL_LOWER <= (value & 0xFF) && (value & 0xFF) <= BANK_OF_PS_VAL_UPPER)) {
-    return false;
-  }
-  return true;
-}
-
-//----------------------------------------------------------------------------//
-template <typename T>
-bool OpenIMU300::isValidConfigRequest(const T value, const T* validValues, const uint8_t len)
+bool OpenIMU300::isValidBankOfPSPacket(uint32_t value)
 {
-  for(size_t i = 0; i < len; i++)
-  {
-      if(value == validValues[i])
-        return true;
-  }
-  return false;
+  return BANK_OF_PS_VAL_LOWER <= value && value <= BANK_OF_PS_VAL_UPPER;
 }
 
 //----------------------------------------------------------------------------//
@@ -111,7 +134,7 @@ void OpenIMU300::getBankOfPSPacket(uint8_t bank, uint8_t *reg ,dwCANMessage *pac
   if(bank > 2)
     return;
 
-  pgn info = IMU300pgnList[BOPS_BANK0 + bank];
+  pgn info = pgnList[BOPS_BANK0 + bank];
 
   packet->id = 0x18000000;
   packet->id |= (info.PF << 16);
@@ -132,19 +155,62 @@ void OpenIMU300::getPacketIdentifiers(uint32_t message_id, uint8_t *pf, uint8_t
 
 //----------------------------------------------------------------------------//
 
-imuMessages OpenIMU300::findExtendedDataPacket(uint8_t pf, uint8_t ps)
+// Builds the (PF, PS) -> imuMessages dispatch table from pgnList.
+// Must be called again whenever a PS value in pgnList changes.
+// Non data packets are inserted first so that a data packet wins if a Bank of
+// PS remapping makes a configuration PGN collide with it. Within each pass the
+// list is walked backwards so the lowest index wins, same as a linear scan.
+void OpenIMU300::buildPgnLookup()
 {
-  for(size_t i = 0; i < sizeof(IMU300pgnList)/sizeof(IMU300pgnList[0]); i++)
+  const size_t pgnCount = sizeof(pgnList)/sizeof(pgnList[0]);
+  uint8_t rows = 0;
+
+  memset(pfRow, PGN_LOOKUP_INVALID, sizeof(pfRow));
+  memset(pgnLookup, PGN_LOOKUP_INVALID, sizeof(pgnLookup));
+
+  for(size_t pass = 0; pass < 2; pass++)
   {
-    if((IMU300pgnList[i].type & DATA_PACKET) != 0)
+    for(size_t i = pgnCount; i-- > 0;)
     {
-      if(IMU300pgnList[i].PF == pf && IMU300pgnList[i].PS == ps)
+      const pgn &info = pgnList[i];
+      bool isData = (info.type & DATA_PACKET) != 0;
+      if(isData != (pass == 1))
+        continue;
+
+      if(pfRow[info.PF] == PGN_LOOKUP_INVALID)
       {
-        return static_cast<imuMessages>(i);
+        if(rows >= PGN_LOOKUP_MAX_PF)
+        {
+          std::cerr << "buildPgnLookup: too many PF values, increase PGN_LOOKUP_MAX_PF\n";
+          continue;
+        }
+        pfRow[info.PF] = rows++;
       }
+      pgnLookup[pfRow[info.PF]][info.PS] = static_cast<uint8_t>(i);
     }
   }
-  return MAX_PGN;
+}
+
+//----------------------------------------------------------------------------//
+
+imuMessages OpenIMU300::lookupPgn(uint8_t pf, uint8_t ps)
+{
+  uint8_t row = pfRow[pf];
+  if(row == PGN_LOOKUP_INVALID || pgnLookup[row][ps] == PGN_LOOKUP_INVALID)
+    return MAX_PGN;
+
+  return static_cast<imuMessages>(pgnLookup[row][ps]);
+}
+
+//----------------------------------------------------------------------------//
+
+imuMessages OpenIMU300::findExtendedDataPacket(uint8_t pf, uint8_t ps)
+{
+  imuMessages msg = lookupPgn(pf, ps);
+  if(msg == MAX_PGN || (pgnList[msg].type & DATA_PACKET) == 0)
+    return MAX_PGN;
+
+  return msg;
 }
 
 imuMessages OpenIMU300::findStandardDataPacket(uint32_t message_id)
@@ -163,159 +229,169 @@ imuMessages OpenIMU300::findStandardDataPacket(uint32_t message_id)
 
 //----------------------------------------------------------------------------//
 
-bool OpenIMU300::getParameterVal(std::string searchString, std::string userString,  uint16_t* value)
+bool OpenIMU300::isValidParam(IMUPARAM_t param, uint32_t value)
 {
-  std::string param;
-  size_t pos = userString.find(searchString);
-  *value = 0;
+  switch(param)
+  {
+    case IMUPARAM_t::PARAM_PACKET_RATE:
+      return validPacketRates.contains(value);
+    case IMUPARAM_t::PARAM_PACKET_TYPE:
+      return validPacketTypes.contains(value);
+    case IMUPARAM_t::PARAM_ORIENTATION:
+      return validOrientations.contains(value);
+    case IMUPARAM_t::PARAM_RATE_LPF:
+    case IMUPARAM_t::PARAM_ACCEL_LPF:
+      return validCutoffFreqs.contains(value);
+    case IMUPARAM_t::PARAM_RESET_ALGO:
+      return value == 1;
+    case IMUPARAM_t::PARAM_RESET_ALGO_PS:
+    case IMUPARAM_t::PARAM_SET_PACKET_RATE_PS:
+    case IMUPARAM_t::PARAM_SET_PACKET_TYPE_PS:
+    case IMUPARAM_t::PARAM_SET_FILTER_CUTOFF_PS:
+    case IMUPARAM_t::PARAM_SET_ORIENTATION_PS:
+      return isValidBankOfPSPacket(value);
+    default:
+      return false;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+// One pass over the parameter string. Keys are matched exactly, so
+// "packetRate=" is not found inside "setPacketRatePS=". Keys of the plugin
+// (can-proto=, device=, ...) are skipped. Values are only checked to be
+// numbers here, getParams() validates them.
+bool OpenIMU300::parseParamString(const string &userString, paramValues_t *params)
+{
+  *params = {};
 
-  if (pos != std::string::npos)
+  ParamTokenizer tokenizer(userString.data(), userString.size());
+  paramToken token;
+  while(tokenizer.next(&token))
   {
-      param   = userString.substr(pos);
-      pos     = param.find_first_of(",");
-      param   = param.substr(searchString.length(), pos);
-      *value = static_cast<uint16_t>(stoi(param));
-      return true;
+    size_t key = 0;
+    while(key < OPTION_MAX_KEYS && !token.key.equals(paramKeys[key].data, paramKeys[key].length))
+      key++;
+    if(key == OPTION_MAX_KEYS)
+      continue;
+
+    if(params->given[key])
+    {
+      std::cerr << "OpenIMU300: " << paramKeys[key].data << "= is given more than once\n";
+      return false;
+    }
+
+    paramValueStatus_t status = parseParamValue(token.value, UINT16_MAX, &params->value[key]);
+    if(status != PARAM_VALUE_OK)
+    {
+      std::cerr << "OpenIMU300: " << paramKeys[key].data << "=" << string(token.value.data, token.value.length)
+                << " is " << paramValueError(status) << "\n";
+      return false;
+    }
+    params->given[key] = true;
   }
-  return false;
+  return true;
 }
 
 //----------------------------------------------------------------------------//
 
-bool OpenIMU300::getParams(std::string userString, dwCANMessage **messages , uint8_t *count)
+bool OpenIMU300::getParams(const paramValues_t &params, dwCANMessage **messages , uint8_t *count)
 {
-  bool once = true;
   uint8_t bankOfPS[2][8] = {};
   bool updateBankOfPS[2] = {false,false};
 
   bankOfPS[0][0] = ECUAddress;
   bankOfPS[1][0] = ECUAddress;
 
+  // Nothing is applied unless every value is valid
+  for(size_t i = 0; i < PARAM_MAX_PARAMS; i++)
+  {
+    if(params.given[i] && !isValidParam(static_cast<IMUPARAM_t>(i), params.value[i]))
+    {
+      std::cerr << "OpenIMU300: " << paramKeys[i].data << "=" << params.value[i]
+                << " is not a valid value, see the parameter table\n";
+      return false;
+    }
+  }
+
   memset(this->configMessages, 0, sizeof(this->configMessages));
+  memset(this->configParams, 0, sizeof(this->configParams));
+  configCount = 0;
+  int filterMessage = -1;
 
-  for(size_t i = 0; i < sizeof(paramNames)/sizeof(paramNames[0]); i++)
+  for(size_t i = 0; i < PARAM_MAX_PARAMS; i++)
   {
-    uint16_t val = 0;
-
-    if(getParameterVal(paramNames[i], userString, &val))
+    // Bank of PS parameters come first in IMUPARAM_t. Once they are all read,
+    // add the Bank of PS messages so the plugin sends the PS configuration
+    // before the configuration requests that use the new PS numbers
+    if(i == IMUPARAM_t::PARAM_PACKET_RATE)
     {
-      switch(static_cast<IMUPARAM_t>(i))
+      if(updateBankOfPS[0])
       {
-        case IMUPARAM_t::PARAM_PACKET_RATE:
-            if(!isValidConfigRequest(static_cast<uint8_t>(val & 0xFF), validPacketRates, VALID_PACKET_RATES)){
-              return false;
-            }
-            imuParameter.packetRate  = val;
-          break;
-        case IMUPARAM_t::PARAM_PACKET_TYPE:
-            if(!isValidConfigRequest(static_cast<uint8_t>(val & 0xFF), validPacketTypes, VALID_PACKET_TYPES)){
-              return false;
-            }
-            imuParameter.packetType  = val;
-          break;
-        case IMUPARAM_t::PARAM_ORIENTATION:
-            if(!isValidConfigRequest(val, validOrientations, VALID_ORIENTATIONS)){
-              return false;
-            }
-            imuParameter.orientation = val;
-          break;
-        case IMUPARAM_t::PARAM_RATE_LPF:
-            if(!isValidConfigRequest(static_cast<uint8_t>(val & 0xFF), validCutoffFreqs, VALID_CUTOFF_FREQS)){
-              return false;
-            }
-            imuParameter.rateLPF = val;
-          break;
-        case IMUPARAM_t::PARAM_ACCEL_LPF:
-            if(!isValidConfigRequest(static_cast<uint8_t>(val & 0xFF), validCutoffFreqs, VALID_CUTOFF_FREQS)){
-              return false;
-            }
-            imuParameter.accelLPF = val;
-          break;
-        case IMUPARAM_t::PARAM_RESET_ALGO:
-            if(val != 1)
-            {
-              return false;     // paramVal is not valid
-            }
-            imuParameter.resetAlgo = val;
-          break;
-        case IMUPARAM_t::PARAM_RESET_ALGO_PS:
-            if(!isValidBankOfPSPacket(val)){
-              return false;
-            }
-
-            bankOfPS[0][1] = (val & 0xFF);
-            IMU300pgnList[RESET_ALGORITHM].PS = (val & 0xFF);
-            updateBankOfPS[0] = true;
-          break;
-        case IMUPARAM_t::PARAM_SET_PACKET_RATE_PS:
-            if(!isValidBankOfPSPacket(val)){
-              return false;
-            }
-
-            bankOfPS[1][1] = (val & 0xFF);
-            IMU300pgnList[PACKET_RATE].PS = (val & 0xFF);
-            updateBankOfPS[1] = true;
-          break;
-        case IMUPARAM_t::PARAM_SET_PACKET_TYPE_PS:
-            if(!isValidBankOfPSPacket(val)){
-              return false;
-            }
-
-            bankOfPS[1][2] = (val & 0xFF);
-            IMU300pgnList[PACKET_TYPE].PS = (val & 0xFF);
-            updateBankOfPS[1] = true;
-          break;
-        case IMUPARAM_t::PARAM_SET_FILTER_CUTOFF_PS:
-            if(!isValidBankOfPSPacket(val)){
-              return false;
-            }
-
-            bankOfPS[1][3] = (val & 0xFF);
-            IMU300pgnList[FILTER_FREQ].PS = (val & 0xFF);
-            updateBankOfPS[1] = true;
-          break;
-        case IMUPARAM_t::PARAM_SET_ORIENTATION_PS:
-            if(!isValidBankOfPSPacket(val)){
-              return false;
-            }
-
-            bankOfPS[1][4] = (val & 0xFF);
-            IMU300pgnList[ORIENTATION].PS = (val & 0xFF);
-            updateBankOfPS[1] = true;
-          break;
-        default:
-          // Should never get here
-          return false;
+        configParams[configCount] = 1 << PARAM_RESET_ALGO_PS;
+        getBankOfPSPacket(0, bankOfPS[0], &configMessages[configCount++]);
       }
 
-      // Take care of BankofPS requests here
-      // Once last available BankOfPS parameter is checkd, prepare message and add to configMessages
-      // Insert them in before other ConfigMessages in the configMessages[] so that
-      // Plugin send PS configuration first and then other configuration
-      // requests to the IMU
-      if(static_cast<IMUPARAM_t>(i) > IMUPARAM_t::PARAM_SET_ORIENTATION_PS && once)
+      if(updateBankOfPS[1])
       {
-        once  = false;
-        if(updateBankOfPS[0])
+        for(size_t ps = PARAM_SET_PACKET_RATE_PS; ps <= PARAM_SET_ORIENTATION_PS; ps++)
         {
-          getBankOfPSPacket(0, bankOfPS[0], &configMessages[configCount++]);
-        }
-
-        if(updateBankOfPS[1])
-        {
-          getBankOfPSPacket(1, bankOfPS[1], &configMessages[configCount++]);
+          if(params.given[ps])
+            configParams[configCount] |= 1 << ps;
         }
+        getBankOfPSPacket(1, bankOfPS[1], &configMessages[configCount++]);
       }
+    }
 
-      // Preapare dwCANMessage for all the configuration requests except BankofPS requests.
-      if(static_cast<IMUPARAM_t>(i) >= IMUPARAM_t::PARAM_PACKET_RATE)
-      {
-        getConfigPacket(static_cast<IMUPARAM_t>(i), val, &configMessages[configCount++]);
-        //configMessages.push_back(message);
-      }
+    if(!params.given[i])
+      continue;
+
+    uint16_t val = static_cast<uint16_t>(params.value[i]);
+    if(i >= IMUPARAM_t::PARAM_PACKET_RATE)
+    {
+      addConfigMessage(static_cast<IMUPARAM_t>(i), val, &imuParameter, configMessages, configParams, &configCount,
+                       &filterMessage);
+      continue;
+    }
+
+    switch(static_cast<IMUPARAM_t>(i))
+    {
+      case IMUPARAM_t::PARAM_RESET_ALGO_PS:
+          bankOfPS[0][1] = (val & 0xFF);
+          pgnList[RESET_ALGORITHM].PS = (val & 0xFF);
+          updateBankOfPS[0] = true;
+        break;
+      case IMUPARAM_t::PARAM_SET_PACKET_RATE_PS:
+          bankOfPS[1][1] = (val & 0xFF);
+          pgnList[PACKET_RATE].PS = (val & 0xFF);
+          updateBankOfPS[1] = true;
+        break;
+      case IMUPARAM_t::PARAM_SET_PACKET_TYPE_PS:
+          bankOfPS[1][2] = (val & 0xFF);
+          pgnList[PACKET_TYPE].PS = (val & 0xFF);
+          updateBankOfPS[1] = true;
+        break;
+      case IMUPARAM_t::PARAM_SET_FILTER_CUTOFF_PS:
+          bankOfPS[1][3] = (val & 0xFF);
+          pgnList[FILTER_FREQ].PS = (val & 0xFF);
+          updateBankOfPS[1] = true;
+        break;
+      case IMUPARAM_t::PARAM_SET_ORIENTATION_PS:
+          bankOfPS[1][4] = (val & 0xFF);
+          pgnList[ORIENTATION].PS = (val & 0xFF);
+          updateBankOfPS[1] = true;
+        break;
+      default:
+        // Should never get here
+        return false;
     }
   }
 
+  // Bank of PS parameters may have remapped PS values above
+  buildPgnLookup();
+  startParameter = imuParameter;
+  dataPeriod_us  = static_cast<dwTime_t>(imuParameter.packetRate) * IMU_BASE_PERIOD_US;
+
   *messages = configMessages;
   *count = configCount;
   return true;
@@ -323,34 +399,78 @@ bool OpenIMU300::getParams(std::string userString, dwCANMessage **messages , uin
 
 //----------------------------------------------------------------------------//
 
+// Keeps the value in *values and adds its configuration message, for all
+// parameters except the Bank of PS ones. Rate and accel cutoff share one
+// FILTER_FREQ message carrying both values, *filterMessage is its index once
+// added (-1 before).
+void OpenIMU300::addConfigMessage(IMUPARAM_t param, uint16_t val, imuParameters_t *values, dwCANMessage *messages,
+                                  uint32_t *params, uint8_t *count, int *filterMessage)
+{
+  switch(param)
+  {
+    case IMUPARAM_t::PARAM_PACKET_RATE:
+        values->packetRate  = val;
+      break;
+    case IMUPARAM_t::PARAM_PACKET_TYPE:
+        values->packetType  = val;
+      break;
+    case IMUPARAM_t::PARAM_ORIENTATION:
+        values->orientation = val;
+      break;
+    case IMUPARAM_t::PARAM_RATE_LPF:
+        values->rateLPF = val;
+      break;
+    case IMUPARAM_t::PARAM_ACCEL_LPF:
+        values->accelLPF = val;
+      break;
+    case IMUPARAM_t::PARAM_RESET_ALGO:
+        values->resetAlgo = val;
+      break;
+    default:
+      return;
+  }
+
+  bool filter = (param == IMUPARAM_t::PARAM_RATE_LPF || param == IMUPARAM_t::PARAM_ACCEL_LPF);
+  if(filter && *filterMessage >= 0)
+  {
+    params[*filterMessage] |= 1 << param;
+    getConfigPacket(param, val, *values, &messages[*filterMessage]);
+    return;
+  }
+  if(filter)
+    *filterMessage = *count;
+
+  params[*count] = 1 << param;
+  getConfigPacket(param, val, *values, &messages[(*count)++]);
+}
+
+//----------------------------------------------------------------------------//
+
 void OpenIMU300::printPSList()
 {
-    printf("GET_PACKET %X \r\n",IMU300pgnList[GET_PACKET].PS);
-    printf("ECU_ID %X \r\n",IMU300pgnList[ECU_ID].PS);
-    printf("SOFTWARE_VER %X \r\n",IMU300pgnList[SOFTWARE_VER].PS);
-    printf("RESET_ALGORITHM %X \r\n",IMU300pgnList[RESET_ALGORITHM].PS);
-    printf("SAVE_CONFIGURAITON %X \r\n",IMU300pgnList[SAVE_CONFIGURAITON].PS);
-    printf("PACKET_RATE %X \r\n",IMU300pgnList[PACKET_RATE].PS);
-    printf("PACKET_TYPE %X \r\n",IMU300pgnList[PACKET_TYPE].PS);
-    printf("FILTER_FREQ %X \r\n",IMU300pgnList[FILTER_FREQ].PS);
-    printf("ORIENTATION %X \r\n",IMU300pgnList[ORIENTATION].PS);
-    printf("MAG_ALIGNMENT %X \r\n",IMU300pgnList[MAG_ALIGNMENT].PS);
-    printf("LEVER_ARM %X \r\n",IMU300pgnList[LEVER_ARM].PS);
-    printf("BOPS_BANK0 %X \r\n",IMU300pgnList[BOPS_BANK0].PS);
-    printf("BOPS_BANK1 %X \r\n",IMU300pgnList[BOPS_BANK1].PS);
-    printf("SSI1_PT %X \r\n",IMU300pgnList[SSI1_PT].PS);
-    printf("ANGULAR_RATE_PT %X \r\n",IMU300pgnList[ANGULAR_RATE_PT].PS);
-    printf("ACCEL_PT %X \r\n",IMU300pgnList[ACCEL_PT].PS);
-    printf("MAGNETOMETER_PT %X \r\n",IMU300pgnList[MAGNETOMETER_PT].PS);
+    printf("GET_PACKET %X \r\n",pgnList[GET_PACKET].PS);
+    printf("ECU_ID %X \r\n",pgnList[ECU_ID].PS);
+    printf("SOFTWARE_VER %X \r\n",pgnList[SOFTWARE_VER].PS);
+    printf("RESET_ALGORITHM %X \r\n",pgnList[RESET_ALGORITHM].PS);
+    printf("SAVE_CONFIGURAITON %X \r\n",pgnList[SAVE_CONFIGURAITON].PS);
+    printf("PACKET_RATE %X \r\n",pgnList[PACKET_RATE].PS);
+    printf("PACKET_TYPE %X \r\n",pgnList[PACKET_TYPE].PS);
+    printf("FILTER_FREQ %X \r\n",pgnList[FILTER_FREQ].PS);
+    printf("ORIENTATION %X \r\n",pgnList[ORIENTATION].PS);
+    printf("MAG_ALIGNMENT %X \r\n",pgnList[MAG_ALIGNMENT].PS);
+    printf("LEVER_ARM %X \r\n",pgnList[LEVER_ARM].PS);
+    printf("BOPS_BANK0 %X \r\n",pgnList[BOPS_BANK0].PS);
+    printf("BOPS_BANK1 %X \r\n",pgnList[BOPS_BANK1].PS);
+    printf("SSI1_PT %X \r\n",pgnList[SSI1_PT].PS);
+    printf("ANGULAR_RATE_PT %X \r\n",pgnList[ANGULAR_RATE_PT].PS);
+    printf("ACCEL_PT %X \r\n",pgnList[ACCEL_PT].PS);
+    printf("MAGNETOMETER_PT %X \r\n",pgnList[MAGNETOMETER_PT].PS);
 }
 
 //----------------------------------------------------------------------------//
 
 OpenIMU300::OpenIMU300()
-: SRCAddress(0x00)
-, ECUAddress(0x80)
-, imuParameter(defaultParams)
-, configCount(0)
+: OpenIMU300(0x00, 0x80)
 { }
 
 //----------------------------------------------------------------------------//
@@ -359,8 +479,16 @@ OpenIMU300::OpenIMU300(uint8_t srcAddr, uint8_t destAddr)
 : SRCAddress(srcAddr)
 , ECUAddress(destAddr)
 , imuParameter(defaultParams)
+, startParameter(defaultParams)
+, runtimeParameter(defaultParams)
 , configCount(0)
-{}
+, latencyCompensation(false)
+, canBitrate(CAN_DEFAULT_BITRATE)
+, dataPeriod_us(static_cast<dwTime_t>(defaultParams.packetRate) * IMU_BASE_PERIOD_US)
+{
+  memcpy(pgnList, IMU300pgnList, sizeof(pgnList));
+  buildPgnLookup();
+}
 
 //----------------------------------------------------------------------------//
 
@@ -371,8 +499,31 @@ OpenIMU300::~OpenIMU300()
 
 bool OpenIMU300::init(string paramsString, dwCANMessage **messages, uint8_t *count)
 {
+  paramValues_t params;
+  if(!parseParamString(paramsString, &params))
+    return false;
+
+  if(params.given[OPTION_LATENCY_COMPENSATION])
+  {
+    if(!validFlags.contains(params.value[OPTION_LATENCY_COMPENSATION]))
+    {
+      std::cerr << "OpenIMU300: latencyCompensation= must be 0 or 1\n";
+      return false;
+    }
+    latencyCompensation = (params.value[OPTION_LATENCY_COMPENSATION] == 1);
+  }
+  if(params.given[OPTION_CAN_BITRATE])
+  {
+    if(params.value[OPTION_CAN_BITRATE] == 0)
+    {
+      std::cerr << "OpenIMU300: canBitrate= must not be 0\n";
+      return false;
+    }
+    canBitrate = params.value[OPTION_CAN_BITRATE] * 1000;   // kbit/s
+  }
+
 #ifndef STD_ID
-  bool status = getParams(paramsString, messages, count);
+  bool status = getParams(params, messages, count);
   //printPSList();
   return status;
 #else
@@ -387,7 +538,7 @@ void OpenIMU300::getSensorResetMessage(dwCANMessage *packet)
   if(packet == nullptr)
     return;
 
-  pgn info = IMU300pgnList[SAVE_CONFIGURAITON];
+  pgn info = pgnList[SAVE_CONFIGURAITON];
   packet->id = 0x18000000;
   packet->id |= (info.PF << 16);
   packet->id |= (info.PS << 8);
@@ -409,7 +560,7 @@ bool OpenIMU300::isValidMessage(uint32_t message_id)
 	}
 	return false;
 #else
-	if((message_id & 0x000000FF) != 0x00000080)
+	if((message_id & 0x000000FF) != ECUAddress)
 	{
 		return false;
 	}
@@ -418,26 +569,54 @@ bool OpenIMU300::isValidMessage(uint32_t message_id)
 
 	getPacketIdentifiers(message_id, &pf, &ps);
 
-	for(size_t i = 0; i < sizeof(IMU300pgnList)/sizeof(IMU300pgnList[0]); i++)
-	{
-		if(pf == IMU300pgnList[i].PF && ps == IMU300pgnList[i].PS)
-		{
-			return true;
-		}
-	}
-	return false;
+	return lookupPgn(pf, ps) != MAX_PGN;
  #endif	//STD_ID
 }
 
 //----------------------------------------------------------------------------//
 
-void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessage *packet)
+// One filter per PGN on the source address checked in isValidMessage().
+// Priority and data page bits are masked out the same way.
+uint8_t OpenIMU300::getMessageFilters(canMessageFilter *filters, uint8_t maxFilters)
+{
+  uint8_t count = 0;
+#ifdef STD_ID
+  const uint32_t standardIds[] = {0x5A, 0x5B, 0x5C};
+  for(size_t i = 0; i < sizeof(standardIds)/sizeof(standardIds[0]) && count < maxFilters; i++)
+  {
+    filters[count].id       = standardIds[i];
+    filters[count].mask     = 0x7FF;
+    filters[count].extended = false;
+    count++;
+  }
+#else
+  for(size_t i = 0; i < sizeof(pgnList)/sizeof(pgnList[0]) && count < maxFilters; i++)
+  {
+    const pgn &info = pgnList[i];
+    // Skip duplicates created by Bank of PS remapping
+    if(lookupPgn(info.PF, info.PS) != static_cast<imuMessages>(i))
+      continue;
+
+    filters[count].id       = (info.PF << 16) | (info.PS << 8) | ECUAddress;
+    filters[count].mask     = 0x00FFFFFF;
+    filters[count].extended = true;
+    count++;
+  }
+#endif // STD_ID
+  return count;
+}
+
+//----------------------------------------------------------------------------//
+
+// values holds the settings the message does not change, e.g. the other
+// cutoff frequency of FILTER_FREQ
+void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, const imuParameters_t &values, dwCANMessage *packet)
 {
   switch(static_cast<IMUPARAM_t>(param))
   {
     case IMUPARAM_t::PARAM_PACKET_RATE:
       {
-        pgn info = IMU300pgnList[PACKET_RATE];
+        pgn info = pgnList[PACKET_RATE];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -453,7 +632,7 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
       break;
     case IMUPARAM_t::PARAM_PACKET_TYPE:
       {
-        pgn info = IMU300pgnList[PACKET_TYPE];
+        pgn info = pgnList[PACKET_TYPE];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -470,7 +649,7 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
       break;
     case IMUPARAM_t::PARAM_ORIENTATION:
       {
-        pgn info = IMU300pgnList[ORIENTATION];
+        pgn info = pgnList[ORIENTATION];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -487,7 +666,7 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
       break;
     case IMUPARAM_t::PARAM_RATE_LPF:
       {
-        pgn info = IMU300pgnList[FILTER_FREQ];
+        pgn info = pgnList[FILTER_FREQ];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -497,14 +676,14 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
           packet->size = 3;
           packet->timestamp_us = 0;
           packet->data[0] = this->ECUAddress;
-          packet->data[1] = static_cast<uint8_t>(paramVal);   // Rate LPF byte
-          packet->data[2] = 0;                                // Accel LPF byte
+          packet->data[1] = static_cast<uint8_t>(paramVal);                 // Rate LPF byte
+          packet->data[2] = static_cast<uint8_t>(values.accelLPF);          // Accel LPF byte, kept
         }
       }
       break;
     case IMUPARAM_t::PARAM_ACCEL_LPF:
       {
-        pgn info = IMU300pgnList[FILTER_FREQ];
+        pgn info = pgnList[FILTER_FREQ];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -514,14 +693,14 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
           packet->size = 3;
           packet->timestamp_us = 0;
           packet->data[0] = this->ECUAddress;
-          packet->data[1] = 0;                                // Rate LPF byte
-          packet->data[2] = static_cast<uint8_t>(paramVal);   // Accel LPF byte
+          packet->data[1] = static_cast<uint8_t>(values.rateLPF);           // Rate LPF byte, kept
+          packet->data[2] = static_cast<uint8_t>(paramVal);                 // Accel LPF byte
         }
       }
         break;
     case IMUPARAM_t::PARAM_RESET_ALGO:
       {
-        pgn info = IMU300pgnList[RESET_ALGORITHM];
+        pgn info = pgnList[RESET_ALGORITHM];
         if((info.type & PACKET_TYPE_t::CONFIGURATION_PACKET) != 0)
         {
           packet->id = 0x18000000;
@@ -543,72 +722,276 @@ void OpenIMU300::getConfigPacket(IMUPARAM_t param, uint16_t paramVal, dwCANMessa
 
 //----------------------------------------------------------------------------//
 
-bool OpenIMU300::parseDataPacket(dwCANMessage packet, dwIMUFrame *frame)
+// Request PGN addressed to the IMU for a REQ_CONFIG PGN. The IMU answers with
+// the configuration PGN in the same format as the configuration message.
+// With message, the answer must carry its values, otherwise any answer on the
+// PGN confirms the setting (used for the Bank of PS, which moves the PGN).
+void OpenIMU300::getReadbackRequest(imuMessages setting, const dwCANMessage *message, configReadback_t *readback)
 {
-const float32_t toRad = 0.017453292519943F;
-#ifdef STD_ID
-  imuMessages dataPacketType = findStandardDataPacket(packet.id);
-#else
-  uint8_t pf = 0, ps = 0;
+  const pgn &request = pgnList[GET_PACKET];
+  const pgn &info    = pgnList[setting];
+
+  memset(readback, 0, sizeof(*readback));
+  readback->request.id           = 0x18000000 | (request.PF << 16) | (ECUAddress << 8) | SRCAddress;
+  readback->request.size         = 3;
+  readback->request.timestamp_us = 0;
+  readback->request.data[0]      = info.PS;
+  readback->request.data[1]      = info.PF;
+  readback->request.data[2]      = 0;
+
+  readback->responseId   = (info.PF << 16) | (info.PS << 8) | ECUAddress;
+  readback->responseMask = 0x00FFFFFF;    // Any priority
+
+  // Byte 0 is the address, the values follow
+  for(size_t i = 1; message != nullptr && i < message->size; i++)
+  {
+    readback->expected[i]     = message->data[i];
+    readback->expectedMask[i] = 0xFF;
+  }
+}
 
-  getPacketIdentifiers(packet.id, &pf, &ps);
+//----------------------------------------------------------------------------//
 
-  // TODO: Needs improvement, change from O(n) to O(1)
-  imuMessages dataPacketType = findExtendedDataPacket(pf, ps);
-#endif // STD_ID
-  switch(dataPacketType)
+// Bank of PS messages go first (stage 0), the parameters using the new PS
+// numbers after them (stage 1). Parameters on a REQ_CONFIG PGN are read back,
+// a Bank of PS entry by the IMU answering on the new PS of its PGN.
+uint8_t OpenIMU300::buildConfigSteps(const dwCANMessage *messages, const uint32_t *params, uint8_t messageCount,
+                                     configStep_t *steps, uint8_t maxSteps)
+{
+  static const struct{ IMUPARAM_t param; imuMessages setting; } remapped[] = {
+    {PARAM_SET_PACKET_RATE_PS,   PACKET_RATE},
+    {PARAM_SET_PACKET_TYPE_PS,   PACKET_TYPE},
+    {PARAM_SET_FILTER_CUTOFF_PS, FILTER_FREQ},
+    {PARAM_SET_ORIENTATION_PS,   ORIENTATION},
+  };
+
+  uint8_t count = 0;
+  for(size_t i = 0; i < messageCount && count < maxSteps; i++)
   {
-    case ANGULAR_RATE_PT: // Unit - Rad/S
-    {
-        auto ptr = reinterpret_cast<const angularRate*>(packet.data);
-        frame->turnrate[0] = (static_cast<float32_t>(ptr->roll_rate) * (1/128.0) - 250.0) * toRad;
-        frame->turnrate[1] = (static_cast<float32_t>(ptr->pitch_rate) * (1/128.0) - 250.0)* toRad;
-        frame->turnrate[2] = (static_cast<float32_t>(ptr->yaw_rate) * (1/128.0) - 250.0)  * toRad;
-        frame->flags |= DW_IMU_ROLL_RATE | DW_IMU_PITCH_RATE | DW_IMU_YAW_RATE;
-        break;
-    }
+    configStep_t &step = steps[count++];
+    memset(&step, 0, sizeof(step));
+    step.message = messages[i];
+    step.params  = params[i];
+
+    uint8_t pf = 0, ps = 0;
+    getPacketIdentifiers(messages[i].id, &pf, &ps);
+    imuMessages setting = lookupPgn(pf, ps);
 
-    case SSI1_PT: // Unit - Degree
+    step.stage = (setting == BOPS_BANK0 || setting == BOPS_BANK1) ? 0 : 1;
+    if(setting == BOPS_BANK1)
     {
-        auto ptr = reinterpret_cast<const slopeSensor*>(packet.data);
-        frame->orientation[0] = static_cast<float32_t>(ptr->roll) * (1/32768) - 250.0;
-        frame->orientation[1] = static_cast<float32_t>(ptr->pitch) * (1/32768) - 250.0;
-        frame->orientation[2] = 0;
-        frame->flags |= DW_IMU_ROLL | DW_IMU_PITCH;
-        break;
+      for(size_t r = 0; r < sizeof(remapped)/sizeof(remapped[0]); r++)
+      {
+        if((step.params & (1u << remapped[r].param)) != 0 && step.readbackCount < CONFIG_STEP_MAX_READBACKS)
+          getReadbackRequest(remapped[r].setting, nullptr, &step.readbacks[step.readbackCount++]);
+      }
     }
-
-    case ACCEL_PT : // Unit - m/s^2
+    else if(setting != MAX_PGN && pgnList[setting].type == REQ_CONFIG_PACKET)
     {
-        auto ptr = reinterpret_cast<const accelSensor*>(packet.data);
-        frame->acceleration[0] = static_cast<float32_t>(ptr-> acceleration_x) * 0.01f - 320.0;
-        frame->acceleration[1] = static_cast<float32_t>(ptr-> acceleration_y) * 0.01f - 320.0;
-        frame->acceleration[2] = static_cast<float32_t>(ptr-> acceleration_z) * 0.01f - 320.0;
-        frame->flags |= DW_IMU_ACCELERATION_X | DW_IMU_ACCELERATION_Y | DW_IMU_ACCELERATION_Z;
-        break;
+      getReadbackRequest(setting, &step.message, &step.readbacks[step.readbackCount++]);
     }
+  }
+  return count;
+}
+
+//----------------------------------------------------------------------------//
+
+// The configuration of init() is sent again at each start, runtime changes
+// made while the sensor ran before are undone
+uint8_t OpenIMU300::getConfigSteps(configStep_t *steps, uint8_t maxSteps)
+{
+  {
+    std::lock_guard<std::mutex> guard(runtimeLock);
+    imuParameter  = startParameter;
+    dataPeriod_us = static_cast<dwTime_t>(startParameter.packetRate) * IMU_BASE_PERIOD_US;
+  }
+  return buildConfigSteps(configMessages, configParams, configCount, steps, maxSteps);
+}
+
+//----------------------------------------------------------------------------//
+
+// Same format as init(), limited to the parameters that do not move PGNs or
+// reset the sensor. The steps are built from the confirmed values in
+// imuParameter, so a change of one cutoff frequency sends the other one as the
+// sensor holds it. The new values only replace them in commitRuntimeConfig().
+bool OpenIMU300::getRuntimeConfigSteps(string paramsString, configStep_t *steps, uint8_t *count, dwTime_t *newPeriod_us)
+{
+  paramValues_t params;
+  if(!parseParamString(paramsString, &params))
+    return false;
+
+  size_t given = 0;
+  for(size_t i = 0; i < OPTION_MAX_KEYS; i++)
+  {
+    if(!params.given[i])
+      continue;
 
-    case MAGNETOMETER_PT: // Unit - utesla
+    bool runtime = (i == PARAM_PACKET_RATE || i == PARAM_PACKET_TYPE || i == PARAM_ORIENTATION ||
+                    i == PARAM_RATE_LPF || i == PARAM_ACCEL_LPF);
+    if(!runtime)
     {
-        auto ptr = reinterpret_cast<const magSensor*>(packet.data);
-        frame->magnetometer[0] = ((static_cast<float32_t>(ptr->mag_x) * 0.00025f) - 8) * (100 /*To uTesla*/);
-        frame->magnetometer[1] = ((static_cast<float32_t>(ptr->mag_y) * 0.00025f) - 8) * (100 /*To uTesla*/);
-        frame->magnetometer[2] = ((static_cast<float32_t>(ptr->mag_z) * 0.00025f) - 8) * (100 /*To uTesla*/);
-        frame->flags |= DW_IMU_MAGNETOMETER_X | DW_IMU_MAGNETOMETER_Y | DW_IMU_MAGNETOMETER_Z;
-        break;
+      std::cerr << "OpenIMU300: " << paramKeys[i].data << "= cannot be changed while the sensor streams\n";
+      return false;
     }
-    /*
-    case ADDRESS_CLAIM_PT:
+    if(!isValidParam(static_cast<IMUPARAM_t>(i), params.value[i]))
     {
-        // For future implemntation of dynamic address claim
-        break;
-    }
-    */
-    default:
+      std::cerr << "OpenIMU300: " << paramKeys[i].data << "=" << params.value[i]
+                << " is not a valid value, see the parameter table\n";
       return false;
+    }
+    given++;
   }
+  if(given == 0)
+  {
+    std::cerr << "OpenIMU300: no parameter to change\n";
+    return false;
+  }
+
+  dwCANMessage messages[PARAM_MAX_PARAMS] = {};
+  uint32_t     messageParams[PARAM_MAX_PARAMS] = {};
+  uint8_t      messageCount  = 0;
+  int          filterMessage = -1;
+
+  std::lock_guard<std::mutex> guard(runtimeLock);
+  runtimeParameter = imuParameter;
+  for(size_t i = PARAM_PACKET_RATE; i < PARAM_MAX_PARAMS; i++)
+  {
+    if(params.given[i])
+      addConfigMessage(static_cast<IMUPARAM_t>(i), static_cast<uint16_t>(params.value[i]), &runtimeParameter,
+                       messages, messageParams, &messageCount, &filterMessage);
+  }
+
+  *count         = buildConfigSteps(messages, messageParams, messageCount, steps, *count);
+  *newPeriod_us  = params.given[PARAM_PACKET_RATE]
+                 ? static_cast<dwTime_t>(params.value[PARAM_PACKET_RATE]) * IMU_BASE_PERIOD_US : -1;
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+void OpenIMU300::setDataPeriod(dwTime_t period_us)
+{
+  dataPeriod_us = period_us;
+}
+
+//----------------------------------------------------------------------------//
+
+dwTime_t OpenIMU300::getDataPeriod() const
+{
+  return dataPeriod_us.load(std::memory_order_relaxed);
+}
 
+//----------------------------------------------------------------------------//
+
+void OpenIMU300::commitRuntimeConfig(uint32_t params)
+{
+  std::lock_guard<std::mutex> guard(runtimeLock);
+  if(params & (1u << PARAM_PACKET_RATE))
+    imuParameter.packetRate  = runtimeParameter.packetRate;
+  if(params & (1u << PARAM_PACKET_TYPE))
+    imuParameter.packetType  = runtimeParameter.packetType;
+  if(params & (1u << PARAM_ORIENTATION))
+    imuParameter.orientation = runtimeParameter.orientation;
+  if(params & (1u << PARAM_RATE_LPF))
+    imuParameter.rateLPF     = runtimeParameter.rateLPF;
+  if(params & (1u << PARAM_ACCEL_LPF))
+    imuParameter.accelLPF    = runtimeParameter.accelLPF;
+}
+
+//----------------------------------------------------------------------------//
+
+// Save Configuration: request 0, ECU address, 0. The IMU answers on the same
+// PGN with response 1, its address and 1 on success.
+bool OpenIMU300::getSaveConfigStep(configStep_t *step)
+{
+  const pgn &info = pgnList[SAVE_CONFIGURAITON];
+
+  memset(step, 0, sizeof(*step));
+  step->message.id   = 0x18000000 | (info.PF << 16) | (info.PS << 8) | SRCAddress;
+  step->message.size = 3;
+  step->message.data[0] = 0;
+  step->message.data[1] = ECUAddress;
+  step->message.data[2] = 0;
+
+  configReadback_t &answer = step->readbacks[step->readbackCount++];
+  answer.responseId      = (info.PF << 16) | (info.PS << 8) | ECUAddress;
+  answer.responseMask    = 0x00FFFFFF;
+  answer.expected[0]     = 1;
+  answer.expectedMask[0] = 0xFF;
+  answer.expected[2]     = 1;
+  answer.expectedMask[2] = 0xFF;
+
+  step->stage = UINT8_MAX;    // After everything else
   return true;
 }
 
 //----------------------------------------------------------------------------//
+
+const char* OpenIMU300::getConfigParamName(uint8_t param)
+{
+  return param < PARAM_MAX_PARAMS ? paramKeys[param].data : nullptr;
+}
+
+//----------------------------------------------------------------------------//
+
+// Moves the frame timestamp from the bus receive time to the sample time:
+//  - receive jitter is removed with a per PGN estimator on the packetRate grid
+//  - the transmission time of the frame at canBitrate is subtracted
+//  - the measurement latency reported by the sensor is subtracted
+void OpenIMU300::compensateTimestamp(imuMessages type, const dwCANMessage &packet, uint8_t sensorLatency, dwIMUFrame *frame)
+{
+  if(!latencyCompensation)
+    return;
+
+  // Frame bits without stuffing, 29-bit identifier
+  uint32_t frameBits   = 67 + 8 * packet.size;
+  dwTime_t wireTime_us = static_cast<dwTime_t>(frameBits) * 1000000 / canBitrate;
+
+  sampleClock[type].setPeriod(dataPeriod_us.load(std::memory_order_relaxed));
+  frame->timestamp_us = sampleClock[type].update(frame->timestamp_us)
+                      - wireTime_us
+                      - static_cast<dwTime_t>(sensorLatency) * IMU_LATENCY_UNIT_US;
+}
+
+//----------------------------------------------------------------------------//
+
+imuMessages OpenIMU300::findDataPacket(uint32_t message_id)
+{
+#ifdef STD_ID
+  return findStandardDataPacket(message_id);
+#else
+  uint8_t pf = 0, ps = 0;
+
+  getPacketIdentifiers(message_id, &pf, &ps);
+
+  return findExtendedDataPacket(pf, ps);
+#endif // STD_ID
+}
+
+//----------------------------------------------------------------------------//
+
+bool OpenIMU300::parseDataPacket(const dwCANMessage &packet, dwIMUFrame *frame)
+{
+  imuMessages dataPacketType = findDataPacket(packet.id);
+  uint8_t sensorLatency      = 0;
+  if(!decodePayload(dataPacketType, packet.data, frame, &sensorLatency))
+    return false;
+
+  compensateTimestamp(dataPacketType, packet, sensorLatency, frame);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
+bool OpenIMU300::decodePayload(imuMessages type, const uint8_t *payload, dwIMUFrame *frame, uint8_t *sensorLatency)
+{
+  packetDecodeFn decode = dataPacketDecoders::decode[type];
+  if(decode == nullptr)
+    return false;
+
+  *sensorLatency = decode(payload, frame);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+
@@ -0,0 +1,180 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <plugin_stats.h>
+
+#ifdef IMU_PLUGIN_STATS
+
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+
+PluginStats::PluginStats()
+: pgnCount(0)
+, otherMessages(0)
+, file(nullptr)
+, period_ms(PLUGIN_STATS_DEFAULT_PERIOD_MS)
+, running(false)
+{
+  for(size_t i = 0; i < PLUGIN_STATS_MAX_PGNS; i++)
+  {
+    pgns[i].store(0, std::memory_order_relaxed);
+    messages[i].store(0, std::memory_order_relaxed);
+    failures[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+PluginStats::~PluginStats()
+{
+  stopDump();
+}
+
+//----------------------------------------------------------------------------//
+
+// Linear search, a sensor sees a handful of data PGNs
+void PluginStats::countMessage(uint32_t id, bool decoded)
+{
+  const uint32_t pgn   = (id >> 8) & 0x3FFFF;
+  const uint32_t count = pgnCount.load(std::memory_order_relaxed);
+
+  size_t i = 0;
+  while(i < count && pgns[i].load(std::memory_order_relaxed) != pgn)
+    i++;
+
+  if(i == count)
+  {
+    if(count == PLUGIN_STATS_MAX_PGNS)
+    {
+      otherMessages.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pgns[i].store(pgn, std::memory_order_relaxed);
+    pgnCount.store(count + 1, std::memory_order_release);
+  }
+
+  messages[i].fetch_add(1, std::memory_order_relaxed);
+  if(!decoded)
+    failures[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------//
+
+void PluginStats::snapshot(pluginStats_t *stats) const
+{
+  for(size_t stage = 0; stage < PLUGIN_STAGE_COUNT; stage++)
+    stages[stage].snapshot(&stats->stages[stage]);
+
+  stats->pgnCount = pgnCount.load(std::memory_order_acquire);
+  for(size_t i = 0; i < PLUGIN_STATS_MAX_PGNS; i++)
+  {
+    bool used                     = i < stats->pgnCount;
+    stats->pgns[i].pgn            = used ? pgns[i].load(std::memory_order_relaxed) : 0;
+    stats->pgns[i].messages       = used ? messages[i].load(std::memory_order_relaxed) : 0;
+    stats->pgns[i].decodeFailures = used ? failures[i].load(std::memory_order_relaxed) : 0;
+  }
+  stats->otherMessages = otherMessages.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus PluginStats::dump(const std::string &path, uint32_t period)
+{
+  stopDump();
+
+  file = fopen(path.c_str(), "a");
+  if(file == nullptr)
+  {
+    std::cerr << "PluginStats: cannot open " << path << ", " << strerror(errno) << std::endl;
+    return DW_FILE_NOT_FOUND;
+  }
+
+  period_ms = period;
+  running   = true;
+  dumper    = std::thread(&PluginStats::dumpLoop, this);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void PluginStats::stopDump()
+{
+  if(file == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    running = false;
+  }
+  signal.notify_one();
+  if(dumper.joinable())
+    dumper.join();
+
+  fclose(file);
+  file = nullptr;
+}
+
+//----------------------------------------------------------------------------//
+
+void PluginStats::dumpLoop()
+{
+  pluginStats_t stats;
+  std::unique_lock<std::mutex> guard(lock);
+  while(running)
+  {
+    signal.wait_for(guard, std::chrono::milliseconds(period_ms));
+
+    // Final snapshot on stop as well, so short runs leave a record
+    snapshot(&stats);
+    write(stats);
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+void PluginStats::write(const pluginStats_t &stats)
+{
+  static const char *stageNames[PLUGIN_STAGE_COUNT] = {"can_read", "filter", "push", "parse", "emit"};
+
+  auto wallClock = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count();
+  fprintf(file, "{\"time_us\": %lld, \"stages\": {", static_cast<long long>(wallClock));
+  for(size_t stage = 0; stage < PLUGIN_STAGE_COUNT; stage++)
+  {
+    const latencyHistogram_t &h = stats.stages[stage];
+    fprintf(file, "%s\"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+            stage == 0 ? "" : ", ", stageNames[stage],
+            static_cast<unsigned long long>(h.count),
+            static_cast<unsigned long long>(h.count ? h.sum_ns / h.count : 0),
+            static_cast<unsigned long long>(LatencyHistogram::percentile(h, 0.5)),
+            static_cast<unsigned long long>(LatencyHistogram::percentile(h, 0.99)),
+            static_cast<unsigned long long>(h.max_ns));
+  }
+  fprintf(file, "}, \"pgns\": [");
+  for(size_t i = 0; i < stats.pgnCount; i++)
+  {
+    fprintf(file, "%s{\"pgn\": %u, \"messages\": %llu, \"decode_failures\": %llu}", i == 0 ? "" : ", ",
+            stats.pgns[i].pgn,
+            static_cast<unsigned long long>(stats.pgns[i].messages),
+            static_cast<unsigned long long>(stats.pgns[i].decodeFailures));
+  }
+  fprintf(file, "], \"other_messages\": %llu}\n", static_cast<unsigned long long>(stats.otherMessages));
+  fflush(file);
+}
+
+//----------------------------------------------------------------------------//
+
+#endif // IMU_PLUGIN_STATS
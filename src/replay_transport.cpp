@@ -0,0 +1,233 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <replay_transport.h>
+#include <can_recorder.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <thread>
+
+//----------------------------------------------------------------------------//
+
+ReplayCANTransport::ReplayCANTransport(bool realtime)
+: realtime(realtime)
+, mapping(MAP_FAILED)
+, mappingSize(0)
+, records(nullptr)
+, recordCount(0)
+, nextRecord(0)
+, firstTimestamp(0)
+{ }
+
+//----------------------------------------------------------------------------//
+
+ReplayCANTransport::~ReplayCANTransport()
+{
+  release();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::open(const std::string &path)
+{
+  struct stat info;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    std::cerr << "ReplayCANTransport: cannot open " << path << ", " << strerror(errno) << std::endl;
+    return DW_FILE_NOT_FOUND;
+  }
+
+  if(fstat(fd, &info) < 0 || info.st_size == 0)
+  {
+    std::cerr << "ReplayCANTransport: " << path << " is empty\n";
+    close(fd);
+    return DW_FILE_INVALID;
+  }
+
+  mappingSize = static_cast<size_t>(info.st_size);
+  mapping     = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED)
+  {
+    std::cerr << "ReplayCANTransport: cannot map " << path << ", " << strerror(errno) << std::endl;
+    return DW_FAILURE;
+  }
+  // Advice values are not flags, each needs its own call
+  madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+  madvise(mapping, mappingSize, MADV_WILLNEED);
+
+  // Compact recording made with record=, expanded once into memory
+  if(CANRecorder::isRecording(static_cast<const uint8_t*>(mapping), mappingSize))
+  {
+    size_t truncated = 0;
+    dwStatus status  = CANRecorder::decode(static_cast<const uint8_t*>(mapping), mappingSize, &decoded, &truncated);
+    unmap();
+    if(status != DW_SUCCESS)
+    {
+      std::cerr << "ReplayCANTransport: " << path << " is a corrupt recording\n";
+      return status;
+    }
+    if(truncated != 0)
+    {
+      std::cerr << "ReplayCANTransport: " << path << " ends in an incomplete record, " << truncated
+                << " bytes ignored\n";
+    }
+    records     = decoded.data();
+    recordCount = decoded.size();
+    nextRecord  = 0;
+    return DW_SUCCESS;
+  }
+
+  if((mappingSize % sizeof(dwCANMessage)) != 0)
+  {
+    std::cerr << "ReplayCANTransport: " << path << " is not a dwCANMessage capture\n";
+    unmap();
+    return DW_FILE_INVALID;
+  }
+
+  records     = static_cast<const dwCANMessage*>(mapping);
+  recordCount = mappingSize / sizeof(dwCANMessage);
+  nextRecord  = 0;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::start()
+{
+  if(records == nullptr)
+    return DW_NOT_INITIALIZED;
+
+  // Replay time restarts at the next record
+  if(nextRecord < recordCount)
+    firstTimestamp = records[nextRecord].timestamp_us;
+  startTime = std::chrono::steady_clock::now();
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::stop()
+{
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::reset()
+{
+  nextRecord = 0;
+  return start();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::release()
+{
+  unmap();
+  decoded.clear();
+  decoded.shrink_to_fit();
+  records     = nullptr;
+  recordCount = 0;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void ReplayCANTransport::unmap()
+{
+  if(mapping != MAP_FAILED)
+  {
+    munmap(mapping, mappingSize);
+    mapping = MAP_FAILED;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::waitUntilDue(const dwCANMessage *message, dwTime_t timeout_us)
+{
+  if(!realtime)
+    return DW_SUCCESS;
+
+  auto due = startTime + std::chrono::microseconds(message->timestamp_us - firstTimestamp);
+  auto now = std::chrono::steady_clock::now();
+  if(due <= now)
+    return DW_SUCCESS;
+
+  if(due - now > std::chrono::microseconds(timeout_us))
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(timeout_us));
+    return DW_TIME_OUT;
+  }
+  std::this_thread::sleep_until(due);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::readMessageRef(const dwCANMessage **message, dwTime_t timeout_us)
+{
+  if(records == nullptr)
+    return DW_NOT_INITIALIZED;
+  if(nextRecord >= recordCount)
+    return DW_END_OF_STREAM;
+
+  dwStatus status = waitUntilDue(&records[nextRecord], timeout_us);
+  if(status != DW_SUCCESS)
+    return status;
+
+  *message = &records[nextRecord++];
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::readMessage(dwCANMessage *message, dwTime_t timeout_us)
+{
+  const dwCANMessage *record = nullptr;
+  dwStatus status = readMessageRef(&record, timeout_us);
+  if(status == DW_SUCCESS)
+    *message = *record;
+  return status;
+}
+
+//----------------------------------------------------------------------------//
+
+// Nothing to send to, configuration messages are dropped
+dwStatus ReplayCANTransport::sendMessage(const dwCANMessage *, dwTime_t)
+{
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus ReplayCANTransport::setFilters(const canMessageFilter *, uint8_t)
+{
+  return DW_NOT_SUPPORTED;
+}
+
+//----------------------------------------------------------------------------//
+
+bool ReplayCANTransport::ownsMessage(const dwCANMessage *message) const
+{
+  return records != nullptr && message >= records && message < records + recordCount;
+}
+
+//----------------------------------------------------------------------------//
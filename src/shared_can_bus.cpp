@@ -0,0 +1,369 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <shared_can_bus.h>
+#include <iostream>
+#include <map>
+#include <thread>
+
+//----------------------------------------------------------------------------//
+
+std::shared_ptr<SharedCANBus> SharedCANBus::get(const std::string &key, const transportFactory_t &create, dwStatus *status)
+{
+  static std::mutex registryLock;
+  static std::map<std::string, std::weak_ptr<SharedCANBus>> registry;
+
+  std::lock_guard<std::mutex> guard(registryLock);
+  std::shared_ptr<SharedCANBus> bus = registry[key].lock();
+  if(bus)
+  {
+    *status = DW_SUCCESS;
+    return bus;
+  }
+
+  std::unique_ptr<CANTransport> transport;
+  *status = create(&transport);
+  if(*status != DW_SUCCESS)
+    return nullptr;
+
+  bus = std::make_shared<SharedCANBus>(std::move(transport));
+  registry[key] = bus;
+  return bus;
+}
+
+//----------------------------------------------------------------------------//
+
+SharedCANBus::SharedCANBus(std::unique_ptr<CANTransport> transport)
+: transport(std::move(transport))
+, routing(false)
+, startedClients(0)
+, readerRunning(false)
+, readCount(0)
+{
+  for(auto &route : routes)
+    route.store(nullptr, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------//
+
+SharedCANBus::~SharedCANBus()
+{
+  readerRunning = false;
+  if(reader.joinable())
+    reader.join();
+
+  transport->stop();
+  transport->release();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::attach(SharedBusTransport *client, uint8_t address)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if(routes[address].load(std::memory_order_relaxed) != nullptr)
+  {
+    std::cerr << "SharedCANBus: address " << static_cast<int>(address) << " is already used by another sensor\n";
+    return DW_BUSY;
+  }
+  routes[address].store(client, std::memory_order_release);
+  clients.push_back(client);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void SharedCANBus::detach(SharedBusTransport *client)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for(auto &route : routes)
+  {
+    if(route.load(std::memory_order_relaxed) == client)
+      route.store(nullptr, std::memory_order_seq_cst);
+  }
+
+  // Pairs with the reader: it either sees the cleared route, or sets routing
+  // before its lookup and the wait covers the delivery
+  while(routing.load(std::memory_order_seq_cst))
+    std::this_thread::yield();
+
+  for(auto it = clients.begin(); it != clients.end(); ++it)
+  {
+    if(*it == client)
+    {
+      clients.erase(it);
+      break;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::start(SharedBusTransport *)
+{
+  std::lock_guard<std::mutex> run(runLock);
+  std::lock_guard<std::mutex> guard(lock);
+  if(startedClients++ > 0)
+    return DW_SUCCESS;
+
+  dwStatus status = transport->start();
+  if(status != DW_SUCCESS)
+  {
+    startedClients--;
+    return status;
+  }
+
+  readerRunning = true;
+  reader        = std::thread(&SharedCANBus::readerLoop, this);
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::stop(SharedBusTransport *)
+{
+  // A start() by another sensor waits until the old reader has been joined
+  std::lock_guard<std::mutex> run(runLock);
+  std::unique_lock<std::mutex> guard(lock);
+  if(startedClients == 0 || --startedClients > 0)
+    return DW_SUCCESS;
+
+  // The reader takes the lock at the end of the stream, join without holding it
+  readerRunning = false;
+  guard.unlock();
+  if(reader.joinable())
+    reader.join();
+
+  return transport->stop();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::reset()
+{
+  std::lock_guard<std::mutex> guard(sendLock);
+  return transport->reset();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::send(const dwCANMessage *message, dwTime_t timeout_us)
+{
+  std::lock_guard<std::mutex> guard(sendLock);
+  return transport->sendMessage(message, timeout_us);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedCANBus::updateFilters()
+{
+  std::vector<canMessageFilter> all;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for(const SharedBusTransport *client : clients)
+      all.insert(all.end(), client->getFilters().begin(), client->getFilters().end());
+  }
+
+  if(all.empty() || all.size() > 255)
+    return DW_NOT_SUPPORTED;
+  return transport->setFilters(all.data(), static_cast<uint8_t>(all.size()));
+}
+
+//----------------------------------------------------------------------------//
+
+void SharedCANBus::readerLoop()
+{
+  dwCANMessage message;
+  uint64_t failures = 0;
+  while(readerRunning)
+  {
+    dwStatus status = transport->readMessage(&message, SHARED_BUS_POLL_TIMEOUT_US);
+    if(status == DW_END_OF_STREAM)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      for(SharedBusTransport *client : clients)
+        client->endOfStream();
+      break;
+    }
+    if(status != DW_SUCCESS && status != DW_TIME_OUT)
+    {
+      // E.g. bus-off or the interface went down, do not spin on a read that fails at once
+      if(failures++ == 0)
+        std::cerr << "SharedCANBus: read failed (" << status << "), retrying every "
+                  << SHARED_BUS_POLL_TIMEOUT_US << " us\n";
+      std::this_thread::sleep_for(std::chrono::microseconds(SHARED_BUS_POLL_TIMEOUT_US));
+      continue;
+    }
+    if(failures > 0)
+    {
+      std::cerr << "SharedCANBus: read recovered after " << failures << " failures\n";
+      failures = 0;
+    }
+    if(status != DW_SUCCESS)
+      continue;
+
+    readCount.fetch_add(1, std::memory_order_relaxed);
+
+    routing.store(true, std::memory_order_seq_cst);
+    SharedBusTransport *client = routes[message.id & 0xFF].load(std::memory_order_seq_cst);
+    if(client != nullptr)
+      client->deliver(message);
+    routing.store(false, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+SharedBusTransport::SharedBusTransport(std::shared_ptr<SharedCANBus> bus, uint8_t address)
+: bus(std::move(bus))
+, address(address)
+, attached(false)
+, started(false)
+, waiting(false)
+, ended(false)
+{ }
+
+//----------------------------------------------------------------------------//
+
+SharedBusTransport::~SharedBusTransport()
+{
+  release();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::attach()
+{
+  dwStatus status = bus->attach(this, address);
+  attached        = (status == DW_SUCCESS);
+  return status;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::start()
+{
+  if(started)
+    return DW_SUCCESS;
+
+  ended = false;
+  queue.clear();
+  dwStatus status = bus->start(this);
+  started         = (status == DW_SUCCESS);
+  return status;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::stop()
+{
+  if(!started)
+    return DW_SUCCESS;
+
+  started = false;
+  return bus->stop(this);
+}
+
+//----------------------------------------------------------------------------//
+
+// Only drops this sensor's queue, the bus keeps running for the other sensors
+dwStatus SharedBusTransport::reset()
+{
+  queue.clear();
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::release()
+{
+  stop();
+  if(attached)
+  {
+    bus->detach(this);
+    attached = false;
+  }
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+void SharedBusTransport::deliver(const dwCANMessage &message)
+{
+  if(!queue.push(message))
+    return;
+
+  // Pairs with the fence in readMessage(), one of the two sides sees the other
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(waiting)
+  {
+    std::lock_guard<std::mutex> guard(waitLock);
+    signal.notify_one();
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+void SharedBusTransport::endOfStream()
+{
+  ended = true;
+  std::lock_guard<std::mutex> guard(waitLock);
+  signal.notify_one();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::readMessage(dwCANMessage *message, dwTime_t timeout_us)
+{
+  const dwCANMessage *received = queue.front();
+  if(received == nullptr && timeout_us > 0)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    std::unique_lock<std::mutex> guard(waitLock);
+    waiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while((received = queue.front()) == nullptr && !ended)
+    {
+      if(signal.wait_until(guard, deadline) == std::cv_status::timeout)
+      {
+        received = queue.front();
+        break;
+      }
+    }
+    waiting = false;
+  }
+
+  if(received == nullptr)
+    return ended ? DW_END_OF_STREAM : DW_TIME_OUT;
+
+  *message = *received;
+  queue.pop();
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::sendMessage(const dwCANMessage *message, dwTime_t timeout_us)
+{
+  return bus->send(message, timeout_us);
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SharedBusTransport::setFilters(const canMessageFilter *filters, uint8_t count)
+{
+  this->filters.assign(filters, filters + count);
+  return bus->updateFilters();
+}
+
+//----------------------------------------------------------------------------//
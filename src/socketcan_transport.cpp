@@ -0,0 +1,405 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <socketcan_transport.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+//----------------------------------------------------------------------------//
+
+SocketCANTransport::SocketCANTransport(size_t batchSize)
+: socketFd(-1)
+, batchSize(batchSize == 0 ? 1 : std::min(batchSize, static_cast<size_t>(SOCKETCAN_MAX_BATCH)))
+, batchCount(0)
+, batchIndex(0)
+, timestampSource(TIMESTAMP_HOST)
+, frames(this->batchSize)
+, iovecs(this->batchSize)
+, headers(this->batchSize)
+, control(this->batchSize * SOCKETCAN_CONTROL_SIZE)
+, timestamps(this->batchSize)
+{
+  for(size_t i = 0; i < this->batchSize; i++)
+  {
+    iovecs[i].iov_base  = &frames[i];
+    iovecs[i].iov_len   = sizeof(struct can_frame);
+    memset(&headers[i], 0, sizeof(headers[i]));
+    headers[i].msg_hdr.msg_iov    = &iovecs[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+SocketCANTransport::~SocketCANTransport()
+{
+  release();
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::open(const std::string &device)
+{
+  struct ifreq ifr;
+  struct sockaddr_can addr;
+
+  if(device.empty() || device.length() >= IFNAMSIZ)
+  {
+    std::cerr << "SocketCANTransport: invalid device name '" << device << "'\n";
+    return DW_INVALID_ARGUMENT;
+  }
+
+  socketFd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+  if(socketFd < 0)
+  {
+    std::cerr << "SocketCANTransport: cannot create socket, " << strerror(errno) << std::endl;
+    return DW_FAILURE;
+  }
+
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, device.c_str(), IFNAMSIZ - 1);
+  if(ioctl(socketFd, SIOCGIFINDEX, &ifr) < 0)
+  {
+    std::cerr << "SocketCANTransport: unknown interface " << device << ", " << strerror(errno) << std::endl;
+    release();
+    return DW_FAILURE;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family  = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if(bind(socketFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    std::cerr << "SocketCANTransport: cannot bind to " << device << ", " << strerror(errno) << std::endl;
+    release();
+    return DW_FAILURE;
+  }
+
+  deviceName = device;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::setTimestampSource(canTimestampSource_t source)
+{
+  int flags = 0;
+
+  if(socketFd < 0)
+    return DW_NOT_INITIALIZED;
+
+  // Most drivers only stamp received frames once the device is told to
+  if(source == TIMESTAMP_HARDWARE)
+  {
+    struct hwtstamp_config config;
+    struct ifreq ifr;
+
+    memset(&config, 0, sizeof(config));
+    config.tx_type   = HWTSTAMP_TX_OFF;
+    config.rx_filter = HWTSTAMP_FILTER_ALL;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, deviceName.c_str(), IFNAMSIZ - 1);
+    ifr.ifr_data = reinterpret_cast<char*>(&config);
+    if(ioctl(socketFd, SIOCSHWTSTAMP, &ifr) < 0 || config.rx_filter == HWTSTAMP_FILTER_NONE)
+    {
+      std::cerr << "SocketCANTransport: cannot enable hardware timestamps on " << deviceName << ", " << strerror(errno) << std::endl;
+      return DW_NOT_SUPPORTED;
+    }
+  }
+
+  // Software timestamps are also requested in hardware mode, a stream that
+  // turns out to carry no hardware timestamps switches to them once
+  if(source == TIMESTAMP_KERNEL || source == TIMESTAMP_HARDWARE)
+    flags |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  if(source == TIMESTAMP_HARDWARE)
+    flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+
+  if(setsockopt(socketFd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+  {
+    std::cerr << "SocketCANTransport: cannot enable timestamping, " << strerror(errno) << std::endl;
+    return DW_NOT_SUPPORTED;
+  }
+
+  timestampSource = source;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::setFilters(const canMessageFilter *filters, uint8_t count)
+{
+  std::vector<struct can_filter> rawFilters(count);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    if(filters[i].extended)
+    {
+      rawFilters[i].can_id   = (filters[i].id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+      rawFilters[i].can_mask = (filters[i].mask & CAN_EFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+    else
+    {
+      rawFilters[i].can_id   = filters[i].id & CAN_SFF_MASK;
+      rawFilters[i].can_mask = (filters[i].mask & CAN_SFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+  }
+
+  if(setsockopt(socketFd, SOL_CAN_RAW, CAN_RAW_FILTER, rawFilters.data(),
+                static_cast<socklen_t>(rawFilters.size() * sizeof(struct can_filter))) < 0)
+  {
+    std::cerr << "SocketCANTransport: cannot install filters, " << strerror(errno) << std::endl;
+    return DW_FAILURE;
+  }
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::start()
+{
+  return socketFd < 0 ? DW_NOT_INITIALIZED : DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::stop()
+{
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::reset()
+{
+  batchIndex = batchCount;
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::release()
+{
+  if(socketFd >= 0)
+  {
+    close(socketFd);
+    socketFd = -1;
+  }
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwTime_t SocketCANTransport::getTimeUs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<dwTime_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+//----------------------------------------------------------------------------//
+
+// Picks the timestamp selected by timestampSource out of the SCM_TIMESTAMPING
+// message, ts[0] is the software and ts[2] the raw hardware timestamp.
+dwTime_t SocketCANTransport::getFrameTimestamp(struct msghdr *header, dwTime_t hostTime)
+{
+  if(timestampSource == TIMESTAMP_HOST)
+    return hostTime;
+
+  for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(header); cmsg != nullptr; cmsg = CMSG_NXTHDR(header, cmsg))
+  {
+    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING)
+      continue;
+
+    struct scm_timestamping stamps;
+    memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+
+    // Adapter and system clock are not mixed within one stream: the first
+    // frame without a hardware timestamp moves the rest of it to kernel time
+    const struct timespec *ts = &stamps.ts[0];
+    if(timestampSource == TIMESTAMP_HARDWARE)
+    {
+      if(stamps.ts[2].tv_sec != 0 || stamps.ts[2].tv_nsec != 0)
+        return static_cast<dwTime_t>(stamps.ts[2].tv_sec) * 1000000 + stamps.ts[2].tv_nsec / 1000;
+
+      std::cerr << "SocketCANTransport: " << deviceName << " gives no hardware timestamps, using kernel timestamps\n";
+      timestampSource = TIMESTAMP_KERNEL;
+    }
+
+    if(ts->tv_sec == 0 && ts->tv_nsec == 0)
+      break;
+    return static_cast<dwTime_t>(ts->tv_sec) * 1000000 + ts->tv_nsec / 1000;
+  }
+  return hostTime;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::waitSocket(short events, dwTime_t timeout_us)
+{
+  struct pollfd pfd;
+  struct timespec timeout;
+
+  pfd.fd          = socketFd;
+  pfd.events      = events;
+  pfd.revents     = 0;
+  timeout.tv_sec  = timeout_us / 1000000;
+  timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+
+  int ready = ppoll(&pfd, 1, &timeout, nullptr);
+  if(ready == 0 || (ready < 0 && errno == EINTR))
+    return DW_TIME_OUT;
+  if(ready < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+    return DW_FAILURE;
+
+  return DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::receiveBatch(dwTime_t timeout_us)
+{
+  if(socketFd < 0)
+    return DW_NOT_INITIALIZED;
+
+  // The kernel shrinks msg_controllen to what it wrote, restore it for every call
+  for(size_t i = 0; i < batchSize; i++)
+  {
+    headers[i].msg_hdr.msg_control    = &control[i * SOCKETCAN_CONTROL_SIZE];
+    headers[i].msg_hdr.msg_controllen = SOCKETCAN_CONTROL_SIZE;
+  }
+
+  int received = recvmmsg(socketFd, headers.data(), static_cast<unsigned int>(batchSize), MSG_DONTWAIT, nullptr);
+  if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    dwStatus status = waitSocket(POLLIN, timeout_us);
+    if(status != DW_SUCCESS)
+      return status;
+
+    received = recvmmsg(socketFd, headers.data(), static_cast<unsigned int>(batchSize), MSG_DONTWAIT, nullptr);
+  }
+
+  if(received < 0)
+  {
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return DW_TIME_OUT;
+
+    std::cerr << "SocketCANTransport: receive failed, " << strerror(errno) << std::endl;
+    return DW_FAILURE;
+  }
+
+  dwTime_t hostTime = getTimeUs();
+  batchCount        = static_cast<size_t>(received);
+  batchIndex        = 0;
+  for(size_t i = 0; i < batchCount; i++)
+  {
+    timestamps[i] = getFrameTimestamp(&headers[i].msg_hdr, hostTime);
+  }
+  return batchCount == 0 ? DW_TIME_OUT : DW_SUCCESS;
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::readMessage(dwCANMessage *message, dwTime_t timeout_us)
+{
+  while(true)
+  {
+    if(batchIndex >= batchCount)
+    {
+      dwStatus status = receiveBatch(timeout_us);
+      if(status != DW_SUCCESS)
+        return status;
+    }
+
+    const struct can_frame &frame = frames[batchIndex];
+    bool complete      = headers[batchIndex].msg_len >= sizeof(struct can_frame);
+    dwTime_t timestamp = timestamps[batchIndex];
+    batchIndex++;
+
+    // Error and remote frames are not IMU data
+    if(!complete || (frame.can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG)) != 0)
+      continue;
+
+    message->id           = frame.can_id & ((frame.can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+    message->size         = frame.can_dlc;
+    message->timestamp_us = timestamp;
+    memcpy(message->data, frame.data, sizeof(frame.data));
+    return DW_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------//
+
+dwStatus SocketCANTransport::sendMessage(const dwCANMessage *message, dwTime_t timeout_us)
+{
+  struct can_frame frame;
+
+  if(socketFd < 0)
+    return DW_NOT_INITIALIZED;
+  if(message->size > CAN_MAX_DLEN)
+    return DW_INVALID_ARGUMENT;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id  = message->id > CAN_SFF_MASK ? ((message->id & CAN_EFF_MASK) | CAN_EFF_FLAG) : message->id;
+  frame.can_dlc = static_cast<uint8_t>(message->size);
+  memcpy(frame.data, message->data, message->size);
+
+  // One deadline for the whole call, a full transmit queue must not turn the
+  // retries into a busy loop
+  auto deadline       = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+  dwTime_t backoff_us = SOCKETCAN_SEND_BACKOFF_MIN_US;
+  while(true)
+  {
+    ssize_t sent = send(socketFd, &frame, sizeof(frame), MSG_DONTWAIT);
+    if(sent == sizeof(frame))
+      return DW_SUCCESS;
+
+    if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS))
+    {
+      bool queueFull = errno == ENOBUFS;
+      auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+      if(left <= 0)
+        return DW_TIME_OUT;
+
+      if(queueFull)
+      {
+        // The device queue is full, e.g. no node ACKs the frames. POLLOUT
+        // still reports ready on a raw CAN socket, so wait instead of polling
+        std::this_thread::sleep_for(std::chrono::microseconds(std::min<dwTime_t>(backoff_us, left)));
+        backoff_us = std::min<dwTime_t>(backoff_us * 2, SOCKETCAN_SEND_BACKOFF_MAX_US);
+        continue;
+      }
+
+      dwStatus status = waitSocket(POLLOUT, left);
+      if(status != DW_SUCCESS)
+        return status;
+      continue;
+    }
+
+    std::cerr << "SocketCANTransport: send failed, " << strerror(errno) << std::endl;
+    return DW_FAILURE;
+  }
+}
+
+//----------------------------------------------------------------------------//
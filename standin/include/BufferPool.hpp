@@ -0,0 +1,72 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: fixed size pool of buffers from the plugin samples.
+
+#ifndef BUFFERPOOL_HPP_
+#define BUFFERPOOL_HPP_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dw
+{
+namespace plugins
+{
+namespace common
+{
+
+template <typename T>
+class BufferPool
+{
+public:
+    BufferPool(size_t poolSize)
+        : m_storage(poolSize)
+    {
+        m_free.reserve(poolSize);
+        for (auto& buffer : m_storage)
+            m_free.push_back(&buffer);
+    }
+
+    bool get(T*& buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_free.empty())
+            return false;
+        buffer = m_free.back();
+        m_free.pop_back();
+        return true;
+    }
+
+    bool put(T* buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (buffer < m_storage.data() || buffer >= m_storage.data() + m_storage.size())
+            return false;
+        m_free.push_back(buffer);
+        return true;
+    }
+
+private:
+    std::vector<T>  m_storage;
+    std::vector<T*> m_free;
+    std::mutex      m_lock;
+};
+
+} // namespace common
+} // namespace plugins
+} // namespace dw
+
+#endif // BUFFERPOOL_HPP_
@@ -0,0 +1,61 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: core types used by the plugin. Only a subset of the SDK
+// declarations, with the same names and layout.
+
+#ifndef DW_CORE_TYPES_H_
+#define DW_CORE_TYPES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef float  float32_t;
+typedef double float64_t;
+typedef int64_t dwTime_t;
+
+typedef enum dwStatus {
+    DW_SUCCESS = 0,
+    DW_INVALID_VERSION,
+    DW_INVALID_ARGUMENT,
+    DW_BAD_ALLOC,
+    DW_BAD_ALIGNMENT,
+    DW_BAD_CAST,
+    DW_NOT_IMPLEMENTED,
+    DW_END_OF_STREAM,
+    DW_INVALID_HANDLE,
+    DW_CALL_NOT_ALLOWED,
+    DW_NOT_AVAILABLE,
+    DW_NOT_RELEASED,
+    DW_NOT_SUPPORTED,
+    DW_NOT_INITIALIZED,
+    DW_INTERNAL_ERROR,
+    DW_FILE_NOT_FOUND,
+    DW_FILE_INVALID,
+    DW_CANNOT_CREATE_OBJECT,
+    DW_BUFFER_FULL,
+    DW_NOT_READY,
+    DW_TIME_OUT,
+    DW_BUSY,
+    DW_FAILURE,
+} dwStatus;
+
+typedef struct dwContextObject* dwContextHandle_t;
+typedef struct dwSALObject*     dwSALHandle_t;
+typedef struct dwSensorObject*  dwSensorHandle_t;
+
+#define DW_NULL_HANDLE NULL
+
+#endif // DW_CORE_TYPES_H_
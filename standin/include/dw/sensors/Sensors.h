@@ -0,0 +1,46 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: sensor abstraction layer. Sensors created here are
+// CAN nodes on the in-memory bus named by device=, see VirtualCANBus.hpp.
+
+#ifndef DW_SENSORS_SENSORS_H_
+#define DW_SENSORS_SENSORS_H_
+
+#include <dw/core/Types.h>
+
+typedef struct dwSensorParams {
+    const char* protocol;
+    const char* parameters;
+} dwSensorParams;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+dwStatus dwSAL_createSensor(dwSensorHandle_t* sensor, dwSensorParams params, dwSALHandle_t sal);
+
+dwStatus dwSAL_releaseSensor(dwSensorHandle_t sensor);
+
+dwStatus dwSensor_start(dwSensorHandle_t sensor);
+
+dwStatus dwSensor_stop(dwSensorHandle_t sensor);
+
+dwStatus dwSensor_reset(dwSensorHandle_t sensor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DW_SENSORS_SENSORS_H_
@@ -0,0 +1,43 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: CAN sensor.
+
+#ifndef DW_SENSORS_CANBUS_CAN_H_
+#define DW_SENSORS_CANBUS_CAN_H_
+
+#include <dw/sensors/Sensors.h>
+
+#define DW_SENSORS_CAN_MAX_MESSAGE_LEN 64
+
+typedef struct dwCANMessage {
+    dwTime_t timestamp_us;
+    uint32_t id;
+    uint16_t size;
+    uint8_t  data[DW_SENSORS_CAN_MAX_MESSAGE_LEN];
+} dwCANMessage;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+dwStatus dwSensorCAN_readMessage(dwCANMessage* msg, dwTime_t timeoutUs, dwSensorHandle_t sensor);
+
+dwStatus dwSensorCAN_sendMessage(const dwCANMessage* msg, dwTime_t timeoutUs, dwSensorHandle_t sensor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DW_SENSORS_CANBUS_CAN_H_
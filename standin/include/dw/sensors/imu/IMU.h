@@ -0,0 +1,50 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: IMU frame.
+
+#ifndef DW_SENSORS_IMU_IMU_H_
+#define DW_SENSORS_IMU_IMU_H_
+
+#include <dw/sensors/Sensors.h>
+
+typedef enum dwIMUFlags {
+    DW_IMU_HEADING        = 1 << 0,
+    DW_IMU_ROLL           = 1 << 1,
+    DW_IMU_PITCH          = 1 << 2,
+    DW_IMU_YAW            = 1 << 3,
+    DW_IMU_ROLL_RATE      = 1 << 4,
+    DW_IMU_PITCH_RATE     = 1 << 5,
+    DW_IMU_YAW_RATE       = 1 << 6,
+    DW_IMU_ACCELERATION_X = 1 << 7,
+    DW_IMU_ACCELERATION_Y = 1 << 8,
+    DW_IMU_ACCELERATION_Z = 1 << 9,
+    DW_IMU_MAGNETOMETER_X = 1 << 10,
+    DW_IMU_MAGNETOMETER_Y = 1 << 11,
+    DW_IMU_MAGNETOMETER_Z = 1 << 12,
+    DW_IMU_TEMPERATURE    = 1 << 13,
+} dwIMUFlags;
+
+typedef struct dwIMUFrame {
+    dwTime_t  timestamp_us;
+    float64_t orientation[3];
+    float64_t turnrate[3];
+    float64_t acceleration[3];
+    float64_t magnetometer[3];
+    float64_t heading;
+    float64_t temperature;
+    uint32_t  flags;
+} dwIMUFrame;
+
+#endif // DW_SENSORS_IMU_IMU_H_
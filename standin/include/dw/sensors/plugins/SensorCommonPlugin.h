@@ -0,0 +1,50 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: function table common to all sensor plugins.
+
+#ifndef DW_SENSORS_PLUGINS_SENSORCOMMONPLUGIN_H_
+#define DW_SENSORS_PLUGINS_SENSORCOMMONPLUGIN_H_
+
+#include <dw/sensors/Sensors.h>
+
+typedef void* dwSensorPluginSensorHandle_t;
+
+typedef struct dwSensorPluginProperties {
+    size_t packetSize;
+} dwSensorPluginProperties;
+
+typedef dwStatus (*dwSensorPlugin_createHandle)(dwSensorPluginSensorHandle_t*, dwSensorPluginProperties*, const char*, dwContextHandle_t);
+typedef dwStatus (*dwSensorPlugin_createSensor)(const char*, dwSALHandle_t, dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_start)(dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_stop)(dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_reset)(dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_release)(dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_readRawData)(const uint8_t**, size_t*, dwTime_t*, dwTime_t, dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_returnRawData)(const uint8_t*, dwSensorPluginSensorHandle_t);
+typedef dwStatus (*dwSensorPlugin_pushData)(size_t*, const uint8_t*, const size_t, dwSensorPluginSensorHandle_t);
+
+typedef struct dwSensorCommonPluginFunctions {
+    dwSensorPlugin_createHandle   createHandle;
+    dwSensorPlugin_createSensor   createSensor;
+    dwSensorPlugin_release        release;
+    dwSensorPlugin_start          start;
+    dwSensorPlugin_stop           stop;
+    dwSensorPlugin_reset          reset;
+    dwSensorPlugin_readRawData    readRawData;
+    dwSensorPlugin_returnRawData  returnRawData;
+    dwSensorPlugin_pushData       pushData;
+} dwSensorCommonPluginFunctions;
+
+#endif // DW_SENSORS_PLUGINS_SENSORCOMMONPLUGIN_H_
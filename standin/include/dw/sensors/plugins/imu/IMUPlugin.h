@@ -0,0 +1,40 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+
+// DriveWorks stand-in: IMU plugin function table.
+
+#ifndef DW_SENSORS_PLUGINS_IMU_IMUPLUGIN_H_
+#define DW_SENSORS_PLUGINS_IMU_IMUPLUGIN_H_
+
+#include <dw/sensors/plugins/SensorCommonPlugin.h>
+#include <dw/sensors/imu/IMU.h>
+
+typedef dwStatus (*dwSensorIMUPlugin_parseDataBuffer)(dwIMUFrame*, size_t*, dwSensorPluginSensorHandle_t);
+
+typedef struct dwSensorIMUPluginFunctionTable {
+    dwSensorCommonPluginFunctions     common;
+    dwSensorIMUPlugin_parseDataBuffer parseDataBuffer;
+} dwSensorIMUPluginFunctionTable;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+dwStatus dwSensorIMUPlugin_getFunctionTable(dwSensorIMUPluginFunctionTable* functions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DW_SENSORS_PLUGINS_IMU_IMUPLUGIN_H_
@@ -0,0 +1,115 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// DriveWorks stand-in: in-memory CAN bus.
+//
+// A bus is identified by name. Every CAN sensor created through dwSAL with
+// device=<name> and every VirtualCANPort constructed with that name is a node
+// on it: a message sent by one node is received by all other nodes, stamped
+// with the host time of the transmission like a real receiver would. Test
+// harnesses and device simulators use VirtualCANPort to play the other side
+// of the plugin.
+
+#ifndef DW_STANDIN_VIRTUALCANBUS_HPP_
+#define DW_STANDIN_VIRTUALCANBUS_HPP_
+
+#include <dw/sensors/canbus/CAN.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dw
+{
+namespace standin
+{
+
+const size_t VIRTUAL_CAN_QUEUE_LIMIT = 4096;   // Frames buffered per node, like a socket receive buffer
+
+class VirtualCANPort;
+
+class VirtualCANBus
+{
+public:
+    // Returns the bus with the given name, created on first use. A bus lives
+    // as long as a node is attached to it.
+    static std::shared_ptr<VirtualCANBus> get(const std::string& name);
+
+    // Host time used for receive timestamps, CLOCK_REALTIME in microseconds
+    static dwTime_t now();
+
+    const std::string& name() const
+    {
+        return m_name;
+    }
+
+    VirtualCANBus(const std::string& name)
+        : m_name(name)
+    {
+    }
+
+private:
+    friend class VirtualCANPort;
+
+    void attach(VirtualCANPort* port);
+    void detach(VirtualCANPort* port);
+    void transmit(const VirtualCANPort* sender, const dwCANMessage& message);
+
+    std::string                  m_name;
+    std::mutex                   m_lock;
+    std::vector<VirtualCANPort*> m_ports;
+};
+
+class VirtualCANPort
+{
+public:
+    explicit VirtualCANPort(const std::string& busName, size_t queueLimit = VIRTUAL_CAN_QUEUE_LIMIT);
+
+    ~VirtualCANPort();
+
+    VirtualCANPort(const VirtualCANPort&) = delete;
+    VirtualCANPort& operator=(const VirtualCANPort&) = delete;
+
+    // Transmits to all other nodes on the bus
+    dwStatus send(const dwCANMessage& message);
+
+    // Waits up to timeout_us for a message from another node
+    dwStatus read(dwCANMessage* message, dwTime_t timeout_us);
+
+    // Drops all received messages
+    void clear();
+
+    size_t pending();
+
+    // Messages lost because the receive queue was full
+    uint64_t droppedCount();
+
+private:
+    friend class VirtualCANBus;
+
+    void deliver(const dwCANMessage& message);
+
+    std::shared_ptr<VirtualCANBus> m_bus;
+    std::mutex                     m_lock;
+    std::condition_variable        m_signal;
+    std::deque<dwCANMessage>       m_queue;
+    size_t                         m_queueLimit;
+    uint64_t                       m_dropped;
+};
+
+} // namespace standin
+} // namespace dw
+
+#endif // DW_STANDIN_VIRTUALCANBUS_HPP_
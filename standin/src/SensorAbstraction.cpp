@@ -0,0 +1,145 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// dwSAL and dwSensorCAN entry points of the stand-in. can.* protocols create
+// a node on the in-memory bus given by device=, the bus does not exist
+// outside the process.
+
+#include <dw/sensors/Sensors.h>
+#include <dw/sensors/canbus/CAN.h>
+#include <dw_standin/VirtualCANBus.hpp>
+#include <atomic>
+#include <iostream>
+#include <string>
+
+struct dwSensorObject
+{
+    std::unique_ptr<dw::standin::VirtualCANPort> port;
+    std::atomic<bool> running;
+};
+
+//#######################################################################################
+static bool getSensorParameter(const std::string& params, const std::string& key, std::string* value)
+{
+    size_t pos = 0;
+    while ((pos = params.find(key, pos)) != std::string::npos)
+    {
+        if (pos == 0 || params[pos - 1] == ',')
+        {
+            size_t end = params.find_first_of(",", pos);
+            *value     = params.substr(pos + key.length(), end == std::string::npos ? std::string::npos : end - pos - key.length());
+            return true;
+        }
+        pos += key.length();
+    }
+    return false;
+}
+
+extern "C" {
+
+//#######################################################################################
+dwStatus dwSAL_createSensor(dwSensorHandle_t* sensor, dwSensorParams params, dwSALHandle_t)
+{
+    if (sensor == nullptr || params.protocol == nullptr)
+        return DW_INVALID_ARGUMENT;
+
+    std::string protocol = params.protocol;
+    if (protocol.compare(0, 4, "can.") != 0)
+    {
+        std::cerr << "dwSAL_createSensor: stand-in only provides can.* sensors, not " << protocol << std::endl;
+        return DW_NOT_SUPPORTED;
+    }
+
+    std::string device;
+    if (params.parameters == nullptr || !getSensorParameter(params.parameters, "device=", &device) || device.empty())
+    {
+        std::cerr << "dwSAL_createSensor: device= is required\n";
+        return DW_INVALID_ARGUMENT;
+    }
+
+    dwSensorObject* object = new dwSensorObject();
+    object->port.reset(new dw::standin::VirtualCANPort(device));
+    object->running = false;
+    *sensor         = object;
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSAL_releaseSensor(dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+
+    delete sensor;
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensor_start(dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+
+    // Like a socket opened now, traffic from before the start is not seen
+    sensor->port->clear();
+    sensor->running = true;
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensor_stop(dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+
+    sensor->running = false;
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensor_reset(dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+
+    sensor->port->clear();
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus dwSensorCAN_readMessage(dwCANMessage* msg, dwTime_t timeoutUs, dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+    if (msg == nullptr)
+        return DW_INVALID_ARGUMENT;
+    if (!sensor->running)
+        return DW_NOT_READY;
+
+    return sensor->port->read(msg, timeoutUs);
+}
+
+//#######################################################################################
+dwStatus dwSensorCAN_sendMessage(const dwCANMessage* msg, dwTime_t, dwSensorHandle_t sensor)
+{
+    if (sensor == nullptr)
+        return DW_INVALID_HANDLE;
+    if (msg == nullptr)
+        return DW_INVALID_ARGUMENT;
+    if (!sensor->running)
+        return DW_NOT_READY;
+
+    return sensor->port->send(*msg);
+}
+
+} // extern "C"
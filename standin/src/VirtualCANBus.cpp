@@ -0,0 +1,161 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+#include <dw_standin/VirtualCANBus.hpp>
+#include <chrono>
+#include <map>
+
+namespace dw
+{
+namespace standin
+{
+
+//#######################################################################################
+std::shared_ptr<VirtualCANBus> VirtualCANBus::get(const std::string& name)
+{
+    static std::mutex registryLock;
+    static std::map<std::string, std::weak_ptr<VirtualCANBus>> registry;
+
+    std::lock_guard<std::mutex> lock(registryLock);
+    std::shared_ptr<VirtualCANBus> bus = registry[name].lock();
+    if (!bus)
+    {
+        bus            = std::make_shared<VirtualCANBus>(name);
+        registry[name] = bus;
+    }
+    return bus;
+}
+
+//#######################################################################################
+dwTime_t VirtualCANBus::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+//#######################################################################################
+void VirtualCANBus::attach(VirtualCANPort* port)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_ports.push_back(port);
+}
+
+//#######################################################################################
+void VirtualCANBus::detach(VirtualCANPort* port)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto it = m_ports.begin(); it != m_ports.end(); ++it)
+    {
+        if (*it == port)
+        {
+            m_ports.erase(it);
+            return;
+        }
+    }
+}
+
+//#######################################################################################
+void VirtualCANBus::transmit(const VirtualCANPort* sender, const dwCANMessage& message)
+{
+    dwCANMessage received = message;
+    received.timestamp_us = now();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (VirtualCANPort* port : m_ports)
+    {
+        if (port != sender)
+            port->deliver(received);
+    }
+}
+
+//#######################################################################################
+VirtualCANPort::VirtualCANPort(const std::string& busName, size_t queueLimit)
+    : m_bus(VirtualCANBus::get(busName))
+    , m_queueLimit(queueLimit)
+    , m_dropped(0)
+{
+    m_bus->attach(this);
+}
+
+//#######################################################################################
+VirtualCANPort::~VirtualCANPort()
+{
+    m_bus->detach(this);
+}
+
+//#######################################################################################
+dwStatus VirtualCANPort::send(const dwCANMessage& message)
+{
+    if (message.size > DW_SENSORS_CAN_MAX_MESSAGE_LEN)
+        return DW_INVALID_ARGUMENT;
+
+    m_bus->transmit(this, message);
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+dwStatus VirtualCANPort::read(dwCANMessage* message, dwTime_t timeout_us)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_queue.empty())
+    {
+        if (timeout_us <= 0)
+            return DW_TIME_OUT;
+        if (!m_signal.wait_for(lock, std::chrono::microseconds(timeout_us), [this] { return !m_queue.empty(); }))
+            return DW_TIME_OUT;
+    }
+
+    *message = m_queue.front();
+    m_queue.pop_front();
+    return DW_SUCCESS;
+}
+
+//#######################################################################################
+void VirtualCANPort::clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_queue.clear();
+}
+
+//#######################################################################################
+size_t VirtualCANPort::pending()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_queue.size();
+}
+
+//#######################################################################################
+uint64_t VirtualCANPort::droppedCount()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_dropped;
+}
+
+//#######################################################################################
+void VirtualCANPort::deliver(const dwCANMessage& message)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_queue.size() >= m_queueLimit)
+        {
+            m_dropped++;
+            return;
+        }
+        m_queue.push_back(message);
+    }
+    m_signal.notify_one();
+}
+
+} // namespace standin
+} // namespace dw
@@ -0,0 +1,112 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Unit tests of MessagePool: exhaustion, reference counting, double release and wait().
+
+#include <message_pool.h>
+#include <cstdio>
+#include <set>
+#include <thread>
+
+static int failures = 0;
+
+#define EXPECT(cond)                                                        \
+    do                                                                      \
+    {                                                                       \
+        if(!(cond))                                                         \
+        {                                                                   \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while(0)
+
+// Every slot is handed out once, then the pool is empty until one is released
+static void testExhaustion()
+{
+    MessagePool pool(4);
+    std::set<dwCANMessage*> handedOut;
+    for(int i = 0; i < 4; i++)
+    {
+        dwCANMessage *slot = pool.get();
+        EXPECT(slot != nullptr && pool.owns(slot));
+        handedOut.insert(slot);
+    }
+    EXPECT(handedOut.size() == 4);
+    EXPECT(pool.get() == nullptr);
+
+    dwCANMessage *slot = *handedOut.begin();
+    EXPECT(pool.release(slot));
+    EXPECT(pool.get() == slot);
+    EXPECT(pool.get() == nullptr);
+
+    dwCANMessage foreign;
+    EXPECT(!pool.owns(&foreign));
+    EXPECT(!pool.release(&foreign));
+}
+
+// A slot is free again only once every reference is dropped, in any order
+static void testReferences()
+{
+    MessagePool pool(1);
+    dwCANMessage *slot = pool.get();
+    pool.addRef(slot);
+    pool.addRef(slot);
+
+    pool.release(slot);
+    EXPECT(pool.get() == nullptr);
+    pool.release(slot);
+    EXPECT(pool.get() == nullptr);
+    pool.release(slot);
+    EXPECT(pool.get() == slot);
+}
+
+// A slot released twice is rejected the second time and handed out only once
+static void testDoubleRelease()
+{
+    MessagePool pool(2);
+    dwCANMessage *slot = pool.get();
+    EXPECT(pool.release(slot));
+    EXPECT(!pool.release(slot));
+
+    dwCANMessage *first  = pool.get();
+    dwCANMessage *second = pool.get();
+    EXPECT(first != nullptr && second != nullptr && first != second);
+    EXPECT(pool.get() == nullptr);
+}
+
+// wait() times out on an empty pool and returns a slot released meanwhile
+static void testWait()
+{
+    MessagePool pool(1);
+    dwCANMessage *slot = pool.get();
+    EXPECT(pool.wait(1000) == nullptr);
+
+    std::thread releaser([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        pool.release(slot);
+    });
+    EXPECT(pool.wait(1000000) == slot);
+    releaser.join();
+}
+
+int main()
+{
+    testExhaustion();
+    testReferences();
+    testDoubleRelease();
+    testWait();
+
+    if(failures)
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Unit tests of SPSCRing: clear, wrap-around and batch pop.
+
+#include <spsc_ring.h>
+#include <cstdio>
+
+static int failures = 0;
+
+#define EXPECT(cond)                                                        \
+    do                                                                      \
+    {                                                                       \
+        if(!(cond))                                                         \
+        {                                                                   \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while(0)
+
+typedef SPSCRing<int, 4> Ring;
+
+// clear() must leave the consumer's cached tail in sync with the head
+static void testClear()
+{
+    Ring ring;
+    ring.push(1);
+    EXPECT(ring.front() != nullptr);
+    ring.pop();
+    ring.push(2);
+    ring.push(3);
+    ring.clear();
+
+    EXPECT(ring.size() == 0);
+    EXPECT(ring.front() == nullptr);
+
+    const int *first = nullptr;
+    EXPECT(ring.frontBatch(&first, 4) == 0);
+
+    ring.push(4);
+    EXPECT(ring.front() != nullptr && *ring.front() == 4);
+    ring.pop();
+    EXPECT(ring.size() == 0);
+    EXPECT(ring.front() == nullptr);
+}
+
+// Elements keep their order across the end of the storage
+static void testWrapAround()
+{
+    Ring ring;
+    int next = 0;
+    int expected = 0;
+    for(int round = 0; round < 10; round++)
+    {
+        for(int i = 0; i < 3; i++)
+            EXPECT(ring.push(next++));
+        for(int i = 0; i < 3; i++)
+        {
+            const int *item = ring.front();
+            EXPECT(item != nullptr && *item == expected);
+            expected++;
+            ring.pop();
+        }
+    }
+    EXPECT(ring.front() == nullptr);
+
+    // A full ring rejects and counts the overflow
+    for(int i = 0; i < 4; i++)
+        EXPECT(ring.push(i));
+    EXPECT(!ring.push(4));
+    EXPECT(ring.overflowCount() == 1);
+    EXPECT(ring.size() == 4);
+    EXPECT(ring.highWatermark() == 4);
+}
+
+// frontBatch() stops at the end of the storage, the rest follows on the next call
+static void testBatchPop()
+{
+    Ring ring;
+    ring.push(0);
+    ring.push(1);
+    ring.push(2);
+    ring.pop(3);
+
+    for(int i = 10; i < 14; i++)
+        EXPECT(ring.push(i));
+
+    const int *first = nullptr;
+    size_t count = ring.frontBatch(&first, 8);
+    EXPECT(count == 1);
+    EXPECT(first != nullptr && first[0] == 10);
+    ring.pop(count);
+
+    count = ring.frontBatch(&first, 2);
+    EXPECT(count == 2);
+    EXPECT(first[0] == 11 && first[1] == 12);
+    ring.pop(count);
+
+    count = ring.frontBatch(&first, 8);
+    EXPECT(count == 1);
+    EXPECT(first[0] == 13);
+    ring.pop(count);
+
+    EXPECT(ring.size() == 0);
+    EXPECT(ring.frontBatch(&first, 8) == 0);
+}
+
+int main()
+{
+    testClear();
+    testWrapAround();
+    testBatchPop();
+
+    if(failures)
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+Copyright 2021 ACEINNA, INC
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*******************************************************************************/
+
+// Converts a candump log (candump -l, lines "(sec.usec) iface ID#DATA") to
+// the dwCANMessage capture format replayed by can-proto=can.replay.
+//
+// Usage: candump2dwcan <candump.log> <capture.bin>
+
+#include <dw/sensors/canbus/CAN.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static int hexValue(char c)
+{
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Parses one candump line, returns false for lines that are not data frames
+static bool parseLine(const std::string &line, dwCANMessage *message)
+{
+  unsigned long sec = 0, usec = 0;
+  char iface[32];
+  char frame[160];
+
+  if(sscanf(line.c_str(), " (%lu.%lu) %31s %159s", &sec, &usec, iface, frame) != 4)
+    return false;
+
+  char *hash = strchr(frame, '#');
+  if(hash == nullptr || hash[1] == 'R')       // Remote frame
+    return false;
+  *hash = '\0';
+
+  memset(message, 0, sizeof(*message));
+  message->id           = static_cast<uint32_t>(strtoul(frame, nullptr, 16));
+  message->timestamp_us = static_cast<dwTime_t>(sec) * 1000000 + usec;
+
+  const char *data = hash + 1;
+  if(*data == '#')                             // CAN FD flags nibble
+    data += 2;
+  while(data[0] != '\0' && data[1] != '\0' && message->size < DW_SENSORS_CAN_MAX_MESSAGE_LEN)
+  {
+    if(*data == '.')
+    {
+      data++;
+      continue;
+    }
+    int hi = hexValue(data[0]), lo = hexValue(data[1]);
+    if(hi < 0 || lo < 0)
+      return false;
+    message->data[message->size++] = static_cast<uint8_t>((hi << 4) | lo);
+    data += 2;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <candump.log> <capture.bin>\n";
+    return 1;
+  }
+
+  std::ifstream input(argv[1]);
+  std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+  if(!input || !output)
+  {
+    std::cerr << "Cannot open input or output file\n";
+    return 1;
+  }
+
+  std::string line;
+  size_t converted = 0, skipped = 0;
+  while(std::getline(input, line))
+  {
+    dwCANMessage message;
+    if(!parseLine(line, &message))
+    {
+      skipped++;
+      continue;
+    }
+    output.write(reinterpret_cast<const char*>(&message), sizeof(message));
+    converted++;
+  }
+
+  std::cout << "Converted " << converted << " frames, skipped " << skipped << " lines\n";
+  return output ? 0 : 1;
+}